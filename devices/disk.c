@@ -50,6 +50,10 @@
 #define CMD_READ_SECTOR_RETRY 0x20  /* READ SECTOR with retries. */
 #define CMD_WRITE_SECTOR_RETRY 0x30 /* WRITE SECTOR with retries. */
 
+/* Largest transfer a single READ/WRITE SECTOR command can carry.
+   A sector count of 0 in the register means 256. */
+#define MAX_SECTORS_PER_CMD 256
+
 /* An ATA device. */
 struct disk {
     char name[8];            /* Name, e.g. "hd0:1". */
@@ -87,6 +91,7 @@ static bool check_device_type(struct disk *);
 static void identify_ata_device(struct disk *);
 
 static void select_sector(struct disk *, disk_sector_t);
+static void select_sectors(struct disk *, disk_sector_t, size_t cnt);
 static void issue_pio_command(struct channel *, uint8_t command);
 static void input_sector(struct channel *, void *);
 static void output_sector(struct channel *, const void *);
@@ -245,6 +250,77 @@ void disk_write(struct disk *d, disk_sector_t sec_no, const void *buffer) {
     lock_release(&c->lock);
 }
 
+/* Reads CNT consecutive sectors starting at SEC_NO from disk D
+   into BUFFER, which must have room for CNT * DISK_SECTOR_SIZE
+   bytes.  The whole run is requested with a single READ SECTOR
+   command, so the drive is selected and the LBA programmed only
+   once per MAX_SECTORS_PER_CMD sectors instead of once per sector.
+   Internally synchronizes accesses to disks, so external
+   per-disk locking is unneeded. */
+void disk_read_multiple(struct disk *d, disk_sector_t sec_no, void *buffer, size_t cnt) {
+    struct channel *c;
+    uint8_t *p = buffer;
+
+    ASSERT(d != NULL);
+    ASSERT(buffer != NULL);
+
+    c = d->channel;
+    lock_acquire(&c->lock);
+    while (cnt > 0) {
+        size_t chunk = cnt < MAX_SECTORS_PER_CMD ? cnt : MAX_SECTORS_PER_CMD;
+        size_t i;
+
+        select_sectors(d, sec_no, chunk);
+        issue_pio_command(c, CMD_READ_SECTOR_RETRY);
+        for (i = 0; i < chunk; i++) {
+            sema_down(&c->completion_wait);
+            if (!wait_while_busy(d))
+                PANIC("%s: disk read failed, sector=%" PRDSNu, d->name, (disk_sector_t)(sec_no + i));
+            input_sector(c, p);
+            p += DISK_SECTOR_SIZE;
+        }
+        d->read_cnt += chunk;
+        sec_no += chunk;
+        cnt -= chunk;
+    }
+    lock_release(&c->lock);
+}
+
+/* Writes CNT consecutive sectors starting at SEC_NO to disk D from
+   BUFFER, which must contain CNT * DISK_SECTOR_SIZE bytes, using a
+   single WRITE SECTOR command per MAX_SECTORS_PER_CMD sectors.
+   Returns after the disk has acknowledged receiving the data.
+   Internally synchronizes accesses to disks, so external
+   per-disk locking is unneeded. */
+void disk_write_multiple(struct disk *d, disk_sector_t sec_no, const void *buffer, size_t cnt) {
+    struct channel *c;
+    const uint8_t *p = buffer;
+
+    ASSERT(d != NULL);
+    ASSERT(buffer != NULL);
+
+    c = d->channel;
+    lock_acquire(&c->lock);
+    while (cnt > 0) {
+        size_t chunk = cnt < MAX_SECTORS_PER_CMD ? cnt : MAX_SECTORS_PER_CMD;
+        size_t i;
+
+        select_sectors(d, sec_no, chunk);
+        issue_pio_command(c, CMD_WRITE_SECTOR_RETRY);
+        for (i = 0; i < chunk; i++) {
+            if (!wait_while_busy(d))
+                PANIC("%s: disk write failed, sector=%" PRDSNu, d->name, (disk_sector_t)(sec_no + i));
+            output_sector(c, p);
+            sema_down(&c->completion_wait);
+            p += DISK_SECTOR_SIZE;
+        }
+        d->write_cnt += chunk;
+        sec_no += chunk;
+        cnt -= chunk;
+    }
+    lock_release(&c->lock);
+}
+
 /* Disk detection and identification. */
 
 static void print_ata_string(char *string, size_t size);
@@ -392,13 +468,20 @@ static void print_ata_string(char *string, size_t size) {
    writes SEC_NO to the disk's sector selection registers.  (We
    use LBA mode.) */
 static void select_sector(struct disk *d, disk_sector_t sec_no) {
+    select_sectors(d, sec_no, 1);
+}
+
+/* Like select_sector(), but programs the sector count register
+   for a transfer of CNT sectors starting at SEC_NO. */
+static void select_sectors(struct disk *d, disk_sector_t sec_no, size_t cnt) {
     struct channel *c = d->channel;
 
-    ASSERT(sec_no < d->capacity);
+    ASSERT(cnt > 0 && cnt <= MAX_SECTORS_PER_CMD);
+    ASSERT(sec_no + cnt <= d->capacity);
     ASSERT(sec_no < (1UL << 28));
 
     select_device_wait(d);
-    outb(reg_nsect(c), 1);
+    outb(reg_nsect(c), cnt == MAX_SECTORS_PER_CMD ? 0 : cnt);
     outb(reg_lbal(c), sec_no);
     outb(reg_lbam(c), sec_no >> 8);
     outb(reg_lbah(c), (sec_no >> 16));
@@ -2,6 +2,7 @@
 #define DEVICES_DISK_H
 
 #include <inttypes.h>
+#include <stddef.h>
 #include <stdint.h>
 
 /* Size of a disk sector in bytes. */
@@ -22,6 +23,8 @@ struct disk *disk_get(int chan_no, int dev_no);
 disk_sector_t disk_size(struct disk *);
 void disk_read(struct disk *, disk_sector_t, void *);
 void disk_write(struct disk *, disk_sector_t, const void *);
+void disk_read_multiple(struct disk *, disk_sector_t, void *, size_t cnt);
+void disk_write_multiple(struct disk *, disk_sector_t, const void *, size_t cnt);
 
 void register_disk_inspect_intr();
 #endif /* devices/disk.h */
@@ -36,6 +36,13 @@ enum {
 
     SYS_MOUNT,
     SYS_UMOUNT,
+
+    /* Extra for Project 3 */
+    SYS_MSYNC, /* Write back a range of a memory mapping. */
+    SYS_SPAWN, /* Start a child running a program: fork plus exec. */
+    SYS_MADVISE, /* Give a hint about how a range of memory is used. */
+    SYS_RSS_LIMIT, /* Cap the pages a process keeps in memory. */
+    SYS_SBRK, /* Grow or shrink the heap. */
 };
 
 #endif /* lib/syscall-nr.h */
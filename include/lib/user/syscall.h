@@ -4,6 +4,10 @@
 #include <debug.h>
 #include <stdbool.h>
 #include <stddef.h>
+#include <stdint.h>
+
+#include "vm/advice.h"
+#include "vm/vmstat-nr.h"
 
 /* Process identifier. */
 typedef int pid_t;
@@ -25,6 +29,7 @@ void halt(void) NO_RETURN;
 void exit(int status) NO_RETURN;
 pid_t fork(const char *thread_name);
 int exec(const char *file);
+pid_t spawn(const char *cmd_line);
 int wait(pid_t);
 bool create(const char *file, unsigned initial_size);
 bool remove(const char *file);
@@ -41,6 +46,10 @@ int dup2(int oldfd, int newfd);
 /* Project 3 and optionally project 4. */
 void *mmap(void *addr, size_t length, int writable, int fd, off_t offset);
 void munmap(void *addr);
+int msync(void *addr, size_t length);
+int madvise(void *addr, size_t length, int advice);
+void rss_limit(size_t pages);
+void *sbrk(intptr_t increment);
 
 /* Project 4 only. */
 bool chdir(const char *dir);
@@ -76,4 +85,30 @@ static inline long long get_fs_disk_write_cnt(void) {
     return write_cnt;
 }
 
+/* Page faults of CLASS (enum vm_fault_class) resolved so far, in all
+ * processes or in this one, as SCOPE (VM_FAULT_GLOBAL or
+ * VM_FAULT_PROCESS) says. */
+static inline long long get_vm_fault_cnt(int class, int scope) {
+    long long cnt;
+    asm volatile("int $0x45" : "=a"(cnt) : "d"((long long)class), "c"((long long)scope));
+    return cnt;
+}
+
+/* Page faults of CLASS that took [2^BUCKET, 2^(BUCKET+1)) cycles. */
+static inline long long get_vm_fault_hist(int class, int bucket) {
+    long long cnt;
+    asm volatile("int $0x46" : "=a"(cnt) : "d"((long long)class), "c"((long long)bucket));
+    return cnt;
+}
+
+/* Memory counter STAT (enum vm_mem_stat): the pages of this process in
+ * memory or in swap, the processes killed for want of memory, the most
+ * pages this process has had in memory at once, or its resident limit
+ * in pages, 0 if it has none. */
+static inline long long get_vm_mem(int stat) {
+    long long cnt;
+    asm volatile("int $0x47" : "=a"(cnt) : "d"((long long)stat));
+    return cnt;
+}
+
 #endif /* lib/user/syscall.h */
@@ -2,24 +2,51 @@
 #define THREAD_MMU_H
 
 #include <stdbool.h>
+#include <stddef.h>
 #include <stdint.h>
 
 #include "threads/pte.h"
 
+/* Bytes, and 4 kB pages, mapped by one huge page. */
+#define HPGSIZE (1UL << PDXSHIFT)
+#define HPGCNT (HPGSIZE / PGSIZE)
+
 typedef bool pte_for_each_func(uint64_t *pte, void *va, void *aux);
 
+/* Most pages a TLB batch invalidates one at a time.  Past this, it
+ * flushes the whole address space instead. */
+#define TLB_BATCH_PAGES 32
+
+/* TLB invalidations held back while a run of mappings in one address
+ * space is torn down, so that they can be done in one go. */
+struct tlb_batch {
+    uint64_t *pml4;                /* Address space, or NULL if none yet. */
+    size_t cnt;                    /* Pages to invalidate. */
+    uint64_t va[TLB_BATCH_PAGES];  /* Their addresses, while they fit. */
+};
+
 uint64_t *pml4e_walk(uint64_t *pml4, const uint64_t va, int create);
+uint64_t *pml4e_walk_pde(uint64_t *pml4, const uint64_t va, int create);
 uint64_t *pml4_create(void);
 bool pml4_for_each(uint64_t *, pte_for_each_func *, void *);
 void pml4_destroy(uint64_t *pml4);
 void pml4_activate(uint64_t *pml4);
+void pml4_tlb_init(void);
 void *pml4_get_page(uint64_t *pml4, const void *upage);
 bool pml4_set_page(uint64_t *pml4, void *upage, void *kpage, bool rw);
+bool pml4_set_huge_page(uint64_t *pml4, void *upage, void *kpage, bool rw);
+bool pml4_is_huge(uint64_t *pml4, const void *upage);
 void pml4_clear_page(uint64_t *pml4, void *upage);
+void pml4_unmap_page(uint64_t *pml4, void *upage, struct tlb_batch *batch);
+size_t pml4_unmap_range(uint64_t *pml4, void *start, void *end, struct tlb_batch *batch);
+void tlb_batch_init(struct tlb_batch *batch);
+void tlb_batch_flush(struct tlb_batch *batch);
 bool pml4_is_dirty(uint64_t *pml4, const void *upage);
 void pml4_set_dirty(uint64_t *pml4, const void *upage, bool dirty);
 bool pml4_is_accessed(uint64_t *pml4, const void *upage);
 void pml4_set_accessed(uint64_t *pml4, const void *upage, bool accessed);
+bool pml4_is_writable(uint64_t *pml4, const void *upage);
+void pml4_set_writable(uint64_t *pml4, const void *upage, bool writable);
 
 #define is_writable(pte) (*(pte) & PTE_W)
 #define is_user_pte(pte) (*(pte) & PTE_U)
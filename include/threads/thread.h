@@ -173,6 +173,8 @@ struct thread {
 #ifdef VM
     /* Table for whole virtual memory owned by thread. */
     struct supplemental_page_table spt;
+    void *user_rsp; /* User rsp saved on system call entry. */
+    uint64_t fault_cnt[VM_FAULT_CLASS_CNT]; /* Faults resolved, by class. */
 #endif
 
     /* Owned by thread.c. */
@@ -0,0 +1,14 @@
+#ifndef VM_ADVICE_H
+#define VM_ADVICE_H
+
+/* Access pattern hints for madvise().  Shared with user programs.
+ * MADV_NORMAL and MADV_SEQUENTIAL stay with the regions they are given
+ * for; the other two act once, on the pages there at the time. */
+enum vm_advice {
+    MADV_NORMAL,     /* No particular pattern; the default. */
+    MADV_SEQUENTIAL, /* Read in order, each page once. */
+    MADV_WILLNEED,   /* Needed soon: read in now. */
+    MADV_DONTNEED,   /* Not needed: drop the contents now. */
+};
+
+#endif /* vm/advice.h */
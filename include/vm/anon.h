@@ -5,14 +5,11 @@ struct page;
 enum vm_type;
 
 struct anon_page {
-    vm_initializer *init;
-    enum vm_type type;
-    void *aux;
-    /* Initiate the struct page and maps the pa to the va */
-    bool (*page_initializer)(struct page *, enum vm_type, void *kva);
+    size_t swap_slot; /* Swap slot holding the contents, or SWAP_SLOT_NONE. */
 };
 
 void vm_anon_init(void);
 bool anon_initializer(struct page *page, enum vm_type type, void *kva);
+void anon_share_slot(struct page *page, struct page *src);
 
 #endif
@@ -7,15 +7,15 @@ struct page;
 enum vm_type;
 
 struct file_page {
-    vm_initializer *init;
-    enum vm_type type;
-    void *aux;
-    /* Initiate the struct page and maps the pa to the va */
-    bool (*page_initializer)(struct page *, enum vm_type, void *kva);
+    struct file *file; /* Backing file, owned by the page's region. */
+    off_t ofs;         /* Offset of the page in FILE. */
+    size_t read_bytes; /* Bytes backed by FILE; the rest reads as zero. */
 };
 
 void vm_file_init(void);
 bool file_backed_initializer(struct page *page, enum vm_type type, void *kva);
 void *do_mmap(void *addr, size_t length, int writable, struct file *file, off_t offset);
 void do_munmap(void *va);
+int do_msync(void *addr, size_t length);
+void file_backed_writeback(struct page *page);
 #endif
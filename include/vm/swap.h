@@ -0,0 +1,29 @@
+#ifndef VM_SWAP_H
+#define VM_SWAP_H
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "devices/disk.h"
+#include "threads/vaddr.h"
+
+/* Number of disk sectors backing one swap slot (one page). */
+#define SECTORS_PER_PAGE (PGSIZE / DISK_SECTOR_SIZE)
+
+/* Slot number meaning "not in swap". */
+#define SWAP_SLOT_NONE ((size_t)-1)
+
+/* Slots per cluster: the aligned group of slots read back together. */
+#define SWAP_CLUSTER_SLOTS 8
+
+void swap_init(struct disk *disk);
+size_t swap_alloc(size_t hint);
+void swap_dup(size_t slot);
+void swap_free(size_t slot);
+void swap_read(size_t slot, void *kva);
+uint32_t swap_gen(size_t slot);
+size_t swap_read_cluster(size_t slot, void *buf, uint32_t *gens);
+void swap_write(size_t slot, const void *kva);
+void swap_write_disk(size_t slot, const void *kva);
+
+#endif /* vm/swap.h */
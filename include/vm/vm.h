@@ -1,12 +1,17 @@
 #ifndef VM_VM_H
 #define VM_VM_H
 #include <stdbool.h>
+#include <stdint.h>
+#include "devices/disk.h"
+#include "filesys/off_t.h"
 #include "threads/palloc.h"
 #include "vm/vm_type.h"
 #include "hash.h"
 #include "vm/uninit.h"
 #include "vm/anon.h"
 #include "vm/file.h"
+#include "vm/vma.h"
+#include "vm/vmstat.h"
 #include "string.h"
 #ifdef EFILESYS
 #include "filesys/page_cache.h"
@@ -29,6 +34,9 @@ struct page {
     /* Your implementation */
     struct hash_elem hash_elem;
     bool writable;
+    struct thread *owner; /* Process whose pml4 maps this page. */
+    struct list_elem rmap_elem; /* Element in the reverse map of FRAME. */
+    struct list_elem resident_elem; /* Element in the owner's RESIDENT_LIST. */
     /* Per-type data are binded into the union.
      * Each function automatically detects the current union */
     union {
@@ -41,10 +49,26 @@ struct page {
     };
 };
 
-/* The representation of "frame" */
+/* The representation of "frame".
+ * There is one for every page of the user pool, set up at boot; see
+ * vm_frame_lookup(). */
 struct frame {
     void *kva;
-    struct page *page;
+    struct list rmap;            /* Pages mapping this frame: the reverse map. */
+    int ref_cnt;                 /* Pages mapping this frame (>1 if COW-shared). */
+    int pin_cnt;                 /* Reasons the frame may not be evicted now. */
+    bool huge_accessed;          /* Huge page seen accessed since last tested. */
+    bool busy;                   /* Being written out; see vm_wait_frame(). */
+    struct list_elem frame_elem; /* Element in the global frame table. */
+    uint64_t ksm_sum;            /* Checksum of the contents when last scanned. */
+    struct hash_elem ksm_elem;   /* Element in the same-page merging table. */
+
+    /* Key in the shared text table: the page of an executable that the
+     * frame holds, when it is in that table. */
+    struct hash_elem text_elem;
+    disk_sector_t text_sector; /* Inode of the executable. */
+    off_t text_ofs;            /* File offset of the page. */
+    size_t text_len;           /* Bytes read from the file; the rest is zero. */
 };
 
 /* The function table for page operations.
@@ -68,20 +92,36 @@ struct page_operations {
  * We don't want to force you to obey any specific design for this struct.
  * All designs up to you for this. */
 struct supplemental_page_table {
-    struct hash spt_hash_table;
+    struct hash spt_hash_table; /* Pages touched so far, keyed by va. */
+    struct list vma_list;       /* Regions, sorted by start address. */
+    struct vma *vma_cache;      /* Region of the last vma_find() hit. */
 
-};
+    /* Last page swapped out and its slot, so that a virtual neighbour
+     * swapped out next can take the adjacent slot.  Guarded by
+     * frame_lock, since other threads evict our pages. */
+    void *swap_hint_va;
+    size_t swap_hint_slot;
 
+    /* Footprint, kept by spt_account(): pages mapped to a frame, and
+     * pages whose contents are in swap.  Read by the OOM killer. */
+    size_t resident_pages;
+    size_t swapped_pages;
+    size_t peak_resident_pages; /* Most RESIDENT_PAGES has been. */
+    size_t rss_limit;           /* Most frames to take; 0 if no limit. */
+    struct list resident_list;  /* Pages mapped to a frame, coldest first. */
+    bool oom_killed; /* Chosen by the OOM killer; exits on next fault. */
 
-/* custom structure */
-struct lazy_read_file {
-    struct file *file;
-    off_t ofs;
-    size_t page_read_bytes;
-    size_t page_zero_bytes;
+    /* Heap, grown and shrunk by sbrk(): one anonymous region from
+     * HEAP_START up to BRK rounded up to a page, absent while empty. */
+    void *heap_start;
+    void *brk;
 };
 
 #include "threads/thread.h"
+
+/* Guards the frame table and every page <-> frame link. */
+extern struct lock frame_lock;
+
 void supplemental_page_table_init(struct supplemental_page_table *spt);
 bool supplemental_page_table_copy(struct supplemental_page_table *dst,
                                   struct supplemental_page_table *src);
@@ -89,8 +129,14 @@ void supplemental_page_table_kill(struct supplemental_page_table *spt);
 struct page *spt_find_page(struct supplemental_page_table *spt, void *va);
 bool spt_insert_page(struct supplemental_page_table *spt, struct page *page);
 void spt_remove_page(struct supplemental_page_table *spt, struct page *page);
+void spt_remove_range(struct supplemental_page_table *spt, void *start, void *end);
+void spt_account(struct supplemental_page_table *spt, int resident, int swapped);
+
+/* Pages populated around a fault on a file-backed region ("-fa=N"). */
+extern size_t fault_around_pages;
 
 void vm_init(void);
+void vm_print_stats(void);
 bool vm_try_handle_fault(struct intr_frame *f, void *addr, bool user, bool write, bool not_present);
 
 #define vm_alloc_page(type, upage, writable) \
@@ -99,6 +145,20 @@ bool vm_alloc_page_with_initializer(enum vm_type type, void *upage, bool writabl
                                     vm_initializer *init, void *aux);
 void vm_dealloc_page(struct page *page);
 bool vm_claim_page(void *va);
+bool vm_claim_page_with(void *va, const void *contents);
+bool vm_claim_page_init(void *va, vm_initializer *init, void *aux);
+bool vm_claim_page_from(struct page *page, const void *contents);
+void vm_free_frame(struct page *page);
+void vm_wait_frame(struct page *page);
+bool vm_frame_test_and_clear_dirty(struct frame *frame);
+struct frame *vm_frame_lookup(void *kva);
+bool vm_pin_range(const void *start, size_t size, bool write);
+void vm_unpin_range(const void *start, size_t size);
+size_t vm_readahead_pages(const struct vma *vma);
+int vm_madvise(void *addr, size_t length, int advice);
+void vm_set_rss_limit(size_t pages);
+void vm_heap_init(struct supplemental_page_table *spt);
+void *vm_sbrk(intptr_t increment);
 enum vm_type page_get_type(struct page *page);
 
 #endif /* VM_VM_H */
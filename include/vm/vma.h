@@ -0,0 +1,41 @@
+#ifndef VM_VMA_H
+#define VM_VMA_H
+#include <list.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+#include "filesys/off_t.h"
+#include "vm/advice.h"
+#include "vm/uninit.h"
+#include "vm/vm_type.h"
+
+struct file;
+struct supplemental_page_table;
+
+/* A virtual memory area: a page-aligned range of user addresses whose
+ * pages share one backing and one set of permissions.  Pages inside a
+ * region get their own struct page only when they are first touched. */
+struct vma {
+    void *start;           /* First address of the region. */
+    void *end;             /* One past the last address. */
+    enum vm_type type;     /* Type (and markers) of pages made here. */
+    bool writable;         /* Whether user writes are allowed. */
+    struct file *file;     /* Backing file, or NULL for zero-fill. */
+    off_t ofs;             /* File offset that START maps to. */
+    size_t read_bytes;     /* Bytes taken from FILE; the rest is zero. */
+    vm_initializer *init;  /* Fills a page on its first claim. */
+    enum vm_advice advice; /* MADV_NORMAL or MADV_SEQUENTIAL. */
+    struct list_elem elem; /* Element in the owner's region list. */
+};
+
+void vma_init(struct supplemental_page_table *spt);
+struct vma *vma_create(struct supplemental_page_table *spt, void *start, void *end,
+                       enum vm_type type, bool writable, struct file *file, off_t ofs,
+                       size_t read_bytes, vm_initializer *init);
+struct vma *vma_find(struct supplemental_page_table *spt, const void *va);
+bool vma_is_free(struct supplemental_page_table *spt, const void *start, const void *end);
+void vma_destroy(struct supplemental_page_table *spt, struct vma *vma);
+bool vma_copy(struct supplemental_page_table *dst, struct supplemental_page_table *src);
+void vma_kill(struct supplemental_page_table *spt);
+
+#endif /* vm/vma.h */
@@ -0,0 +1,33 @@
+#ifndef VM_VMSTAT_NR_H
+#define VM_VMSTAT_NR_H
+
+/* Classes of page faults resolved by vm_try_handle_fault().  Shared
+ * with user programs, which name them when reading the counters. */
+enum vm_fault_class {
+    VM_FAULT_FILE,  /* Page read in from a file. */
+    VM_FAULT_ZERO,  /* Anonymous page filled with zeros. */
+    VM_FAULT_STACK, /* Stack page, new or grown into. */
+    VM_FAULT_SWAP,  /* Anonymous page read back from swap. */
+    VM_FAULT_COW,   /* Write to a frame shared copy-on-write. */
+    VM_FAULT_CLASS_CNT
+};
+
+/* Buckets of the fault latency histograms.  Bucket N counts faults
+ * that took [2^N, 2^(N+1)) cycles; the last also counts longer ones. */
+#define VM_FAULT_HIST_BUCKETS 32
+
+/* Scopes of the fault counters. */
+#define VM_FAULT_GLOBAL 0  /* All processes since boot. */
+#define VM_FAULT_PROCESS 1 /* The calling process. */
+
+/* Memory counters read through int 0x47. */
+enum vm_mem_stat {
+    VM_MEM_RESIDENT,  /* Pages of the calling process in memory. */
+    VM_MEM_SWAPPED,   /* Pages of the calling process in swap. */
+    VM_MEM_OOM_KILLS, /* Processes killed for want of memory, since boot. */
+    VM_MEM_PEAK,      /* Most pages of the calling process in memory at once. */
+    VM_MEM_LIMIT,     /* Resident limit of the calling process; 0 if none. */
+    VM_MEM_STAT_CNT
+};
+
+#endif /* vm/vmstat-nr.h */
@@ -0,0 +1,12 @@
+#ifndef VM_VMSTAT_H
+#define VM_VMSTAT_H
+#include <stdint.h>
+
+#include "vm/vmstat-nr.h"
+
+void vmstat_init(void);
+uint64_t vmstat_begin(void);
+void vmstat_end(enum vm_fault_class class, uint64_t start);
+void vmstat_oom_kill(void);
+
+#endif /* vm/vmstat.h */
@@ -0,0 +1,351 @@
+#include <malloc.h>
+
+#include <debug.h>
+#include <round.h>
+#include <stdint.h>
+#include <string.h>
+#include <syscall.h>
+
+/* The heap of a user program.
+
+   Small requests are served the way the kernel's malloc() serves
+   them.  The size of each request is rounded up to a power of 2 and
+   taken from the free list of the descriptor for blocks of that size,
+   which refills its list a page, or "arena", at a time.  Requests too
+   big for any descriptor get contiguous pages of their own, with the
+   page count in the arena header.
+
+   Pages come from the heap, which sbrk() grows.  Pages given back by
+   free() join a list of free runs, sorted by address and merged with
+   their neighbours, from which later requests are served first.  When
+   the run at the top of the heap reaches TRIM_PAGES pages, it is
+   returned to the kernel with a single sbrk() call. */
+
+#define PGSIZE 4096
+
+/* Smallest free run at the top of the heap that is returned to the
+   kernel. */
+#define TRIM_PAGES 16
+
+/* Descriptor. */
+struct desc {
+    size_t block_size;       /* Size of each element in bytes. */
+    size_t blocks_per_arena; /* Number of blocks in an arena. */
+    struct block *free_list; /* First free block. */
+};
+
+/* Magic number for detecting arena corruption. */
+#define ARENA_MAGIC 0x9a548eed
+
+/* Arena. */
+struct arena {
+    unsigned magic;    /* Always set to ARENA_MAGIC. */
+    struct desc *desc; /* Owning descriptor, null for big block. */
+    size_t free_cnt;   /* Free blocks; pages in big block. */
+};
+
+/* Free block. */
+struct block {
+    struct block *prev; /* Previous block in the free list. */
+    struct block *next; /* Next block in the free list. */
+};
+
+/* Run of free pages, described in its first page. */
+struct run {
+    size_t page_cnt;  /* Number of pages. */
+    struct run *next; /* Next run up in the heap. */
+};
+
+/* Our set of descriptors. */
+static struct desc descs[10]; /* Descriptors. */
+static size_t desc_cnt;       /* Number of descriptors. */
+
+/* Free runs, in address order. */
+static struct run *free_runs;
+
+static void malloc_init(void);
+static void *get_pages(size_t page_cnt);
+static void free_pages(void *pages, size_t page_cnt);
+static uint8_t *run_end(struct run *);
+static void block_push(struct desc *, struct block *);
+static void block_remove(struct desc *, struct block *);
+static struct arena *block_to_arena(struct block *);
+static struct block *arena_to_block(struct arena *, size_t idx);
+
+/* Initializes the malloc() descriptors. */
+static void malloc_init(void) {
+    size_t block_size;
+
+    for (block_size = 16; block_size < PGSIZE / 2; block_size *= 2) {
+        struct desc *d = &descs[desc_cnt++];
+        ASSERT(desc_cnt <= sizeof descs / sizeof *descs);
+        d->block_size = block_size;
+        d->blocks_per_arena = (PGSIZE - sizeof(struct arena)) / block_size;
+        d->free_list = NULL;
+    }
+}
+
+/* Obtains and returns a new block of at least SIZE bytes.
+   Returns a null pointer if memory is not available. */
+void *malloc(size_t size) {
+    struct desc *d;
+    struct block *b;
+    struct arena *a;
+
+    /* A null pointer satisfies a request for 0 bytes. */
+    if (size == 0)
+        return NULL;
+    if (desc_cnt == 0)
+        malloc_init();
+
+    /* Find the smallest descriptor that satisfies a SIZE-byte request. */
+    for (d = descs; d < descs + desc_cnt; d++)
+        if (d->block_size >= size)
+            break;
+    if (d == descs + desc_cnt) {
+        /* SIZE is too big for any descriptor.
+           Allocate enough pages to hold SIZE plus an arena. */
+        size_t page_cnt;
+        if (size + sizeof *a < size)
+            return NULL;
+        page_cnt = DIV_ROUND_UP(size + sizeof *a, PGSIZE);
+        a = get_pages(page_cnt);
+        if (a == NULL)
+            return NULL;
+
+        /* Initialize the arena to indicate a big block of PAGE_CNT
+           pages, and return it. */
+        a->magic = ARENA_MAGIC;
+        a->desc = NULL;
+        a->free_cnt = page_cnt;
+        return a + 1;
+    }
+
+    /* If the free list is empty, create a new arena. */
+    if (d->free_list == NULL) {
+        size_t i;
+
+        a = get_pages(1);
+        if (a == NULL)
+            return NULL;
+
+        /* Initialize arena and add its blocks to the free list. */
+        a->magic = ARENA_MAGIC;
+        a->desc = d;
+        a->free_cnt = d->blocks_per_arena;
+        for (i = 0; i < d->blocks_per_arena; i++)
+            block_push(d, arena_to_block(a, i));
+    }
+
+    /* Get a block from free list and return it. */
+    b = d->free_list;
+    block_remove(d, b);
+    a = block_to_arena(b);
+    a->free_cnt--;
+    return b;
+}
+
+/* Allocates and return A times B bytes initialized to zeroes.
+   Returns a null pointer if memory is not available. */
+void *calloc(size_t a, size_t b) {
+    void *p;
+    size_t size;
+
+    /* Calculate block size and make sure it fits in size_t. */
+    size = a * b;
+    if (b != 0 && size / b != a)
+        return NULL;
+
+    /* Allocate and zero memory. */
+    p = malloc(size);
+    if (p != NULL)
+        memset(p, 0, size);
+
+    return p;
+}
+
+/* Returns the number of bytes allocated for BLOCK. */
+static size_t block_size(void *block) {
+    struct block *b = block;
+    struct arena *a = block_to_arena(b);
+    struct desc *d = a->desc;
+
+    return d != NULL ? d->block_size : PGSIZE * a->free_cnt - sizeof *a;
+}
+
+/* Attempts to resize OLD_BLOCK to NEW_SIZE bytes, possibly
+   moving it in the process.
+   If successful, returns the new block; on failure, returns a
+   null pointer.
+   A call with null OLD_BLOCK is equivalent to malloc(NEW_SIZE).
+   A call with zero NEW_SIZE is equivalent to free(OLD_BLOCK). */
+void *realloc(void *old_block, size_t new_size) {
+    if (new_size == 0) {
+        free(old_block);
+        return NULL;
+    } else {
+        void *new_block = malloc(new_size);
+        if (old_block != NULL && new_block != NULL) {
+            size_t old_size = block_size(old_block);
+            size_t min_size = new_size < old_size ? new_size : old_size;
+            memcpy(new_block, old_block, min_size);
+            free(old_block);
+        }
+        return new_block;
+    }
+}
+
+/* Frees block P, which must have been previously allocated with
+   malloc(), calloc(), or realloc(). */
+void free(void *p) {
+    if (p != NULL) {
+        struct block *b = p;
+        struct arena *a = block_to_arena(b);
+        struct desc *d = a->desc;
+
+        if (d != NULL) {
+            /* It's a normal block.  We handle it here. */
+
+#ifndef NDEBUG
+            /* Clear the block to help detect use-after-free bugs. */
+            memset(b, 0xcc, d->block_size);
+#endif
+
+            /* Add block to free list. */
+            block_push(d, b);
+
+            /* If the arena is now entirely unused, free it. */
+            if (++a->free_cnt >= d->blocks_per_arena) {
+                size_t i;
+
+                ASSERT(a->free_cnt == d->blocks_per_arena);
+                for (i = 0; i < d->blocks_per_arena; i++)
+                    block_remove(d, arena_to_block(a, i));
+                free_pages(a, 1);
+            }
+        } else {
+            /* It's a big block.  Free its pages. */
+            free_pages(a, a->free_cnt);
+        }
+    }
+}
+
+/* Returns PAGE_CNT contiguous free pages, or a null pointer if the
+   heap cannot grow to provide them.  The lowest free run that is big
+   enough gives up its bottom pages; failing that, the heap grows,
+   taking in the free run at its top, if there is one. */
+static void *get_pages(size_t page_cnt) {
+    struct run **rp, **top = NULL, *r;
+    uint8_t *brk, *pages;
+    size_t pad;
+
+    if (page_cnt > INTPTR_MAX / PGSIZE)
+        return NULL;
+
+    for (rp = &free_runs; (r = *rp) != NULL; rp = &r->next) {
+        if (r->page_cnt > page_cnt) {
+            struct run *rest = (struct run *)((uint8_t *)r + page_cnt * PGSIZE);
+            rest->page_cnt = r->page_cnt - page_cnt;
+            rest->next = r->next;
+            *rp = rest;
+            return r;
+        } else if (r->page_cnt == page_cnt) {
+            *rp = r->next;
+            return r;
+        }
+        top = rp;
+    }
+
+    brk = sbrk(0);
+    if (top != NULL && run_end(*top) == brk) {
+        r = *top;
+        if (sbrk((page_cnt - r->page_cnt) * PGSIZE) == NULL)
+            return NULL;
+        *top = NULL;
+        return r;
+    }
+
+    /* Someone else may have left the break in the middle of a page. */
+    pad = ROUND_UP((uintptr_t)brk, PGSIZE) - (uintptr_t)brk;
+    pages = sbrk(pad + page_cnt * PGSIZE);
+    return pages != NULL ? pages + pad : NULL;
+}
+
+/* Adds the PAGE_CNT pages at PAGES to the free runs, and returns the
+   run at the top of the heap to the kernel if it has grown to
+   TRIM_PAGES pages. */
+static void free_pages(void *pages, size_t page_cnt) {
+    struct run *run = pages, **rp, **prev = NULL;
+
+    for (rp = &free_runs; *rp != NULL && *rp < run; rp = &(*rp)->next)
+        prev = rp;
+    run->page_cnt = page_cnt;
+    run->next = *rp;
+    *rp = run;
+
+    /* Merge with the runs on either side. */
+    if (run->next != NULL && run_end(run) == (uint8_t *)run->next) {
+        run->page_cnt += run->next->page_cnt;
+        run->next = run->next->next;
+    }
+    if (prev != NULL && run_end(*prev) == (uint8_t *)run) {
+        (*prev)->page_cnt += run->page_cnt;
+        (*prev)->next = run->next;
+        rp = prev;
+        run = *rp;
+    }
+
+    if (run->next == NULL && run->page_cnt >= TRIM_PAGES && run_end(run) == sbrk(0)) {
+        intptr_t size = run->page_cnt * PGSIZE;
+
+        *rp = NULL;
+        sbrk(-size);
+    }
+}
+
+/* Returns the address one past the last page of run R. */
+static uint8_t *run_end(struct run *r) {
+    return (uint8_t *)r + r->page_cnt * PGSIZE;
+}
+
+/* Pushes B on the front of the free list of D. */
+static void block_push(struct desc *d, struct block *b) {
+    b->prev = NULL;
+    b->next = d->free_list;
+    if (b->next != NULL)
+        b->next->prev = b;
+    d->free_list = b;
+}
+
+/* Removes B from the free list of D. */
+static void block_remove(struct desc *d, struct block *b) {
+    if (b->prev != NULL)
+        b->prev->next = b->next;
+    else
+        d->free_list = b->next;
+    if (b->next != NULL)
+        b->next->prev = b->prev;
+}
+
+/* Returns the arena that block B is inside. */
+static struct arena *block_to_arena(struct block *b) {
+    struct arena *a = (struct arena *)ROUND_DOWN((uintptr_t)b, PGSIZE);
+
+    /* Check that the arena is valid. */
+    ASSERT(a != NULL);
+    ASSERT(a->magic == ARENA_MAGIC);
+
+    /* Check that the block is properly aligned for the arena. */
+    ASSERT(a->desc == NULL || ((uintptr_t)b % PGSIZE - sizeof *a) % a->desc->block_size == 0);
+    ASSERT(a->desc != NULL || (uintptr_t)b % PGSIZE == sizeof *a);
+
+    return a;
+}
+
+/* Returns the IDX'th block within arena A. */
+static struct block *arena_to_block(struct arena *a, size_t idx) {
+    ASSERT(a != NULL);
+    ASSERT(a->magic == ARENA_MAGIC);
+    ASSERT(idx < a->desc->blocks_per_arena);
+    return (struct block *)((uint8_t *)a + sizeof *a + idx * a->desc->block_size);
+}
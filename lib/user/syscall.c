@@ -73,6 +73,10 @@ int exec(const char *file) {
     return (pid_t)syscall1(SYS_EXEC, file);
 }
 
+pid_t spawn(const char *cmd_line) {
+    return (pid_t)syscall1(SYS_SPAWN, cmd_line);
+}
+
 int wait(pid_t pid) {
     return syscall1(SYS_WAIT, pid);
 }
@@ -125,6 +129,22 @@ void munmap(void *addr) {
     syscall1(SYS_MUNMAP, addr);
 }
 
+int msync(void *addr, size_t length) {
+    return syscall2(SYS_MSYNC, addr, length);
+}
+
+int madvise(void *addr, size_t length, int advice) {
+    return syscall3(SYS_MADVISE, addr, length, advice);
+}
+
+void rss_limit(size_t pages) {
+    syscall1(SYS_RSS_LIMIT, pages);
+}
+
+void *sbrk(intptr_t increment) {
+    return (void *)syscall1(SYS_SBRK, increment);
+}
+
 bool chdir(const char *dir) {
     return syscall1(SYS_CHDIR, dir);
 }
@@ -0,0 +1,10 @@
+/* Spawns a child process running a program and waits for it. */
+
+#include <syscall.h>
+
+#include "tests/lib.h"
+#include "tests/main.h"
+
+void test_main(void) {
+    msg("wait(spawn()) = %d", wait(spawn("child-simple")));
+}
@@ -0,0 +1,78 @@
+/* Makes page faults of each class that a test can make happen without
+   running short of memory, and checks that each is counted under its
+   own class and that the latency histogram of the class takes it in. */
+
+#include <string.h>
+#include <syscall.h>
+
+#include "tests/lib.h"
+#include "tests/main.h"
+#include "tests/vm/sample.inc"
+
+#define PAGE_SIZE 4096
+#define STACK_PAGES 4
+
+static char data[PAGE_SIZE] __attribute__((aligned(PAGE_SIZE)));
+
+/* Returns the faults of CLASS made by this process so far. */
+static long long faults(int class) {
+    return get_vm_fault_cnt(class, VM_FAULT_PROCESS);
+}
+
+/* Returns the faults of CLASS in its latency histogram. */
+static long long hist_faults(int class) {
+    long long cnt = 0;
+    int i;
+
+    for (i = 0; i < VM_FAULT_HIST_BUCKETS; i++)
+        cnt += get_vm_fault_hist(class, i);
+    return cnt;
+}
+
+/* Grows the stack by about STACK_PAGES pages. */
+static char __attribute__((noinline)) grow_stack(void) {
+    volatile char frame[STACK_PAGES * PAGE_SIZE];
+    int i;
+
+    for (i = 0; i < STACK_PAGES * PAGE_SIZE; i += PAGE_SIZE)
+        frame[i] = 1;
+    return frame[0];
+}
+
+void test_main(void) {
+    char *map_addr = (char *)0x10000000;
+    long long before;
+    int handle;
+    pid_t child;
+
+    before = faults(VM_FAULT_ZERO);
+    data[0] = 1;
+    CHECK(faults(VM_FAULT_ZERO) > before, "zero-fill fault counted");
+
+    before = faults(VM_FAULT_STACK);
+    grow_stack();
+    CHECK(faults(VM_FAULT_STACK) - before >= STACK_PAGES - 1, "stack faults counted");
+
+    CHECK((handle = open("sample.txt")) > 1, "open \"sample.txt\"");
+    CHECK(mmap(map_addr, PAGE_SIZE, 0, handle, 0) != MAP_FAILED, "mmap \"sample.txt\"");
+    before = faults(VM_FAULT_FILE);
+    if (memcmp(map_addr, sample, strlen(sample)))
+        fail("read of mmap'd file reported bad data");
+    CHECK(faults(VM_FAULT_FILE) > before, "file fault counted");
+
+    /* The child's first write to DATA breaks the sharing. */
+    child = fork("child");
+    if (child == 0) {
+        before = faults(VM_FAULT_COW);
+        data[0] = 2;
+        exit(faults(VM_FAULT_COW) > before ? 81 : -1);
+    }
+    CHECK(wait(child) == 81, "copy-on-write fault counted in child");
+    CHECK(data[0] == 1, "parent's copy untouched");
+
+    CHECK(hist_faults(VM_FAULT_ZERO) > 0 && hist_faults(VM_FAULT_STACK) > 0 &&
+              hist_faults(VM_FAULT_FILE) > 0 && hist_faults(VM_FAULT_COW) > 0,
+          "latency histograms take every class");
+    CHECK(get_vm_fault_cnt(VM_FAULT_FILE, VM_FAULT_GLOBAL) >= faults(VM_FAULT_FILE),
+          "global count covers process count");
+}
@@ -0,0 +1,18 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected (IGNORE_EXIT_CODES => 1, [<<'EOF']);
+(fault-stats) begin
+(fault-stats) zero-fill fault counted
+(fault-stats) stack faults counted
+(fault-stats) open "sample.txt"
+(fault-stats) mmap "sample.txt"
+(fault-stats) file fault counted
+(fault-stats) copy-on-write fault counted in child
+(fault-stats) parent's copy untouched
+(fault-stats) latency histograms take every class
+(fault-stats) global count covers process count
+(fault-stats) end
+EOF
+pass;
@@ -0,0 +1,69 @@
+/* Gives each madvise() hint for a buffer and checks that MADV_DONTNEED
+   drops its contents, that MADV_SEQUENTIAL reads a mapped file in
+   fewer faults than no advice, that MADV_WILLNEED reads it in ahead of
+   the accesses, and that bad arguments are refused. */
+
+#include <string.h>
+#include <syscall.h>
+
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define PAGE_SIZE 4096
+#define PAGE_CNT 8
+#define MAP_PAGES 256 /* Of large.txt, which has more. */
+
+static char buf[PAGE_CNT * PAGE_SIZE] __attribute__((aligned(PAGE_SIZE)));
+
+/* Returns the faults of this process that had to read a file or swap. */
+static long long read_faults(void) {
+    return get_vm_fault_cnt(VM_FAULT_FILE, VM_FAULT_PROCESS) +
+           get_vm_fault_cnt(VM_FAULT_SWAP, VM_FAULT_PROCESS);
+}
+
+/* Maps the first MAP_PAGES pages of large.txt at ADDR, gives them
+   ADVICE, and reads them in order.  Returns the faults that took. */
+static long long map_and_read(int handle, char *addr, int advice) {
+    long long before;
+    int i;
+
+    if (mmap(addr, MAP_PAGES * PAGE_SIZE, 0, handle, 0) != addr)
+        fail("mmap \"large.txt\"");
+    if (madvise(addr, MAP_PAGES * PAGE_SIZE, advice) != 0)
+        fail("madvise %d", advice);
+    before = read_faults();
+    for (i = 0; i < MAP_PAGES; i++)
+        if (addr[i * PAGE_SIZE] == '\0')
+            fail("page %d of \"large.txt\" starts with a null byte", i);
+    before = read_faults() - before;
+    munmap(addr);
+    return before;
+}
+
+void test_main(void) {
+    long long normal, sequential;
+    int handle;
+    size_t i;
+
+    memset(buf, 0x5a, sizeof buf);
+    CHECK(madvise(buf, sizeof buf, MADV_SEQUENTIAL) == 0, "madvise SEQUENTIAL");
+    CHECK(madvise(buf, sizeof buf, MADV_WILLNEED) == 0, "madvise WILLNEED");
+    CHECK(madvise(buf, sizeof buf, MADV_NORMAL) == 0, "madvise NORMAL");
+    CHECK(madvise(buf, sizeof buf, MADV_DONTNEED) == 0, "madvise DONTNEED");
+    for (i = 0; i < sizeof buf; i++)
+        if (buf[i] != 0)
+            fail("byte %zu is %d after MADV_DONTNEED", i, buf[i]);
+    msg("dropped pages read as zeros");
+
+    CHECK((handle = open("large.txt")) > 1, "open \"large.txt\"");
+    normal = map_and_read(handle, (char *)0x20000000, MADV_NORMAL);
+    sequential = map_and_read(handle, (char *)0x30000000, MADV_SEQUENTIAL);
+    CHECK(normal > 0 && sequential < normal, "SEQUENTIAL reads in fewer faults");
+    CHECK(map_and_read(handle, (char *)0x40000000, MADV_WILLNEED) == 0,
+          "WILLNEED leaves no faults to take");
+    close(handle);
+
+    CHECK(madvise(buf + 1, PAGE_SIZE, MADV_NORMAL) == -1, "unaligned address refused");
+    CHECK(madvise(buf, sizeof buf, 42) == -1, "unknown advice refused");
+    CHECK(madvise((void *)0x10000000, PAGE_SIZE, MADV_NORMAL) == -1, "unmapped range refused");
+}
@@ -0,0 +1,20 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected (IGNORE_EXIT_CODES => 1, [<<'EOF']);
+(madvise) begin
+(madvise) madvise SEQUENTIAL
+(madvise) madvise WILLNEED
+(madvise) madvise NORMAL
+(madvise) madvise DONTNEED
+(madvise) dropped pages read as zeros
+(madvise) open "large.txt"
+(madvise) SEQUENTIAL reads in fewer faults
+(madvise) WILLNEED leaves no faults to take
+(madvise) unaligned address refused
+(madvise) unknown advice refused
+(madvise) unmapped range refused
+(madvise) end
+EOF
+pass;
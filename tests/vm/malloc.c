@@ -0,0 +1,67 @@
+/* Allocates blocks of many sizes with malloc(), resizes half of them
+   with realloc() and checks their contents along the way.  Freeing
+   everything must hand the heap back to the kernel. */
+
+#include <malloc.h>
+#include <string.h>
+#include <syscall.h>
+
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define BLOCK_CNT 256
+#define BIG_SIZE (64 * 1024)
+
+static char *blocks[BLOCK_CNT];
+static size_t sizes[BLOCK_CNT];
+
+/* Checks that block I holds SIZE bytes of its pattern. */
+static void check_block(int i, size_t size) {
+    size_t j;
+
+    for (j = 0; j < size; j++)
+        if (blocks[i][j] != (char)i)
+            fail("block %d byte %zu is %d, expected %d", i, j, blocks[i][j], (char)i);
+}
+
+void test_main(void) {
+    char *start = sbrk(0);
+    char *big;
+    int i;
+
+    for (i = 0; i < BLOCK_CNT; i++) {
+        sizes[i] = (i * 37) % 3000 + 1;
+        blocks[i] = malloc(sizes[i]);
+        if (blocks[i] == NULL)
+            fail("malloc(%zu) failed", sizes[i]);
+        memset(blocks[i], i, sizes[i]);
+    }
+    for (i = 0; i < BLOCK_CNT; i++)
+        check_block(i, sizes[i]);
+    msg("malloc");
+
+    for (i = 0; i < BLOCK_CNT; i += 2) {
+        size_t old_size = sizes[i];
+
+        sizes[i] = old_size * 3 / 2 + 1;
+        blocks[i] = realloc(blocks[i], sizes[i]);
+        if (blocks[i] == NULL)
+            fail("realloc to %zu failed", sizes[i]);
+        check_block(i, old_size);
+        memset(blocks[i], i, sizes[i]);
+    }
+    for (i = 0; i < BLOCK_CNT; i++)
+        check_block(i, sizes[i]);
+    msg("realloc");
+
+    big = calloc(BIG_SIZE, 1);
+    CHECK(big != NULL, "calloc");
+    for (i = 0; i < BIG_SIZE; i++)
+        if (big[i] != 0)
+            fail("byte %d of calloc'd block is %d", i, big[i]);
+
+    for (i = 0; i < BLOCK_CNT; i++)
+        free(blocks[i]);
+    free(big);
+    CHECK(sbrk(0) == start, "heap returned to the kernel");
+}
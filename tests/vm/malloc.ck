@@ -0,0 +1,13 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected (IGNORE_EXIT_CODES => 1, [<<'EOF']);
+(malloc) begin
+(malloc) malloc
+(malloc) realloc
+(malloc) calloc
+(malloc) heap returned to the kernel
+(malloc) end
+EOF
+pass;
@@ -0,0 +1,60 @@
+/* Forks a child that takes most of memory and swap and then keeps
+   touching it, makes the parent need more than is left, and checks
+   that the child, as the largest process, is the one the OOM killer
+   takes, that the kill is counted, and that the parent goes on with
+   its own pages intact and counted. */
+
+#include <syscall.h>
+
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define PAGE_SIZE 4096
+#define HOG_PAGES 1536 /* 6 MB: more than the user pool, less than it plus swap. */
+#define OWN_PAGES 768  /* 3 MB: more than the child leaves. */
+
+static char hog[HOG_PAGES * PAGE_SIZE] __attribute__((aligned(PAGE_SIZE)));
+static char own[OWN_PAGES * PAGE_SIZE] __attribute__((aligned(PAGE_SIZE)));
+
+/* Body of the child: fills HOG, tells the parent, and keeps it in
+   use until killed. */
+static void run_hog(void) {
+    int i;
+
+    for (i = 0; i < HOG_PAGES; i++)
+        hog[i * PAGE_SIZE] = 1;
+    if (!create("hog-ready", 0))
+        exit(1);
+    for (;;)
+        for (i = 0; i < HOG_PAGES; i++)
+            hog[i * PAGE_SIZE]++;
+}
+
+void test_main(void) {
+    long long kills;
+    pid_t pid;
+    int fd, i;
+
+    kills = get_vm_mem(VM_MEM_OOM_KILLS);
+    pid = fork("hog");
+    if (pid == 0)
+        run_hog();
+    CHECK(pid > 0, "fork \"hog\"");
+    while ((fd = open("hog-ready")) < 0)
+        continue;
+    close(fd);
+    msg("hog holds its memory");
+
+    for (i = 0; i < OWN_PAGES; i++)
+        own[i * PAGE_SIZE] = i;
+    CHECK(get_vm_mem(VM_MEM_OOM_KILLS) == kills + 1, "one process killed for memory");
+    CHECK(wait(pid) == -1, "wait for hog: killed");
+
+    for (i = 0; i < OWN_PAGES; i++)
+        if (own[i * PAGE_SIZE] != (char)i)
+            fail("page %d holds %d, expected %d", i, own[i * PAGE_SIZE], (char)i);
+    msg("own pages intact");
+    CHECK(get_vm_mem(VM_MEM_RESIDENT) + get_vm_mem(VM_MEM_SWAPPED) >= OWN_PAGES,
+          "own pages counted");
+    CHECK(get_vm_mem(VM_MEM_STAT_CNT) == 0, "bad counter reads as zero");
+}
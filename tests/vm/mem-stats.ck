@@ -0,0 +1,16 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected (IGNORE_EXIT_CODES => 1, [<<'EOF']);
+(mem-stats) begin
+(mem-stats) fork "hog"
+(mem-stats) hog holds its memory
+(mem-stats) one process killed for memory
+(mem-stats) wait for hog: killed
+(mem-stats) own pages intact
+(mem-stats) own pages counted
+(mem-stats) bad counter reads as zero
+(mem-stats) end
+EOF
+pass;
@@ -0,0 +1,34 @@
+/* Writes to a file through a mapping and flushes it with msync,
+   then reads the data in the file back using the read system
+   call, while the mapping is still in place, to verify. */
+
+#include <string.h>
+#include <syscall.h>
+
+#include "tests/lib.h"
+#include "tests/main.h"
+#include "tests/vm/sample.inc"
+
+#define ACTUAL ((void *)0x10000000)
+
+void test_main(void) {
+    int handle;
+    void *map;
+    char buf[1024];
+
+    /* Write file via mmap. */
+    CHECK(create("sample.txt", strlen(sample)), "create \"sample.txt\"");
+    CHECK((handle = open("sample.txt")) > 1, "open \"sample.txt\"");
+    CHECK((map = mmap(ACTUAL, 4096, 1, handle, 0)) != MAP_FAILED, "mmap \"sample.txt\"");
+    memcpy(ACTUAL, sample, strlen(sample));
+    CHECK(msync(map, 4096) == 0, "msync \"sample.txt\"");
+
+    /* Read back via read() without unmapping. */
+    read(handle, buf, strlen(sample));
+    CHECK(!memcmp(buf, sample, strlen(sample)), "compare read data against written data");
+
+    /* A range that is not file mapped cannot be synced. */
+    CHECK(msync(ACTUAL + 4096, 4096) == -1, "msync unmapped range");
+    munmap(map);
+    close(handle);
+}
@@ -0,0 +1,41 @@
+/* Caps the resident pages of the process a few pages above what it
+   already uses, writes to many more pages than that, and checks that
+   the process stayed under the cap by swapping out its own pages, at
+   least as many as it went over by, without losing their contents. */
+
+#include <syscall.h>
+
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define PAGE_SIZE 4096
+#define PAGE_CNT 64
+#define HEADROOM 8
+
+static char buf[PAGE_CNT * PAGE_SIZE] __attribute__((aligned(PAGE_SIZE)));
+
+void test_main(void) {
+    long long limit, swapped;
+    int i;
+
+    limit = get_vm_mem(VM_MEM_RESIDENT) + HEADROOM;
+    swapped = get_vm_mem(VM_MEM_SWAPPED);
+    rss_limit(limit);
+    CHECK(get_vm_mem(VM_MEM_LIMIT) == limit, "limit set");
+
+    for (i = 0; i < PAGE_CNT; i++)
+        buf[i * PAGE_SIZE] = i;
+    CHECK(get_vm_mem(VM_MEM_RESIDENT) <= limit, "resident pages within limit");
+    CHECK(get_vm_mem(VM_MEM_PEAK) <= limit, "peak within limit");
+    CHECK(get_vm_mem(VM_MEM_SWAPPED) - swapped >= PAGE_CNT - HEADROOM,
+          "own pages swapped out at the limit");
+
+    for (i = 0; i < PAGE_CNT; i++)
+        if (buf[i * PAGE_SIZE] != i)
+            fail("page %d holds %d, expected %d", i, buf[i * PAGE_SIZE], i);
+    msg("contents intact");
+    CHECK(get_vm_mem(VM_MEM_RESIDENT) <= limit, "still within limit after reading back");
+
+    rss_limit(0);
+    CHECK(get_vm_mem(VM_MEM_LIMIT) == 0, "limit lifted");
+}
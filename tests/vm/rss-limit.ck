@@ -0,0 +1,16 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected (IGNORE_EXIT_CODES => 1, [<<'EOF']);
+(rss-limit) begin
+(rss-limit) limit set
+(rss-limit) resident pages within limit
+(rss-limit) peak within limit
+(rss-limit) own pages swapped out at the limit
+(rss-limit) contents intact
+(rss-limit) still within limit after reading back
+(rss-limit) limit lifted
+(rss-limit) end
+EOF
+pass;
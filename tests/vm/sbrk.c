@@ -0,0 +1,38 @@
+/* Grows the heap with sbrk(), writes to it, shrinks it and checks that
+   the pages dropped are freed and read as zeros once grown back. */
+
+#include <string.h>
+#include <syscall.h>
+
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define PAGE_SIZE 4096
+#define PAGE_CNT 4
+
+void test_main(void) {
+    char *start, *heap;
+    long long resident;
+    int i;
+
+    start = sbrk(0);
+    CHECK(start != NULL, "sbrk(0) returns the break");
+
+    heap = sbrk(PAGE_CNT * PAGE_SIZE);
+    CHECK(heap == start, "sbrk returns the old break");
+    CHECK(sbrk(0) == start + PAGE_CNT * PAGE_SIZE, "break moved");
+    memset(heap, 'x', PAGE_CNT * PAGE_SIZE);
+
+    resident = get_vm_mem(VM_MEM_RESIDENT);
+    CHECK(sbrk(-PAGE_CNT * PAGE_SIZE) == start + PAGE_CNT * PAGE_SIZE, "shrink heap");
+    CHECK(resident - get_vm_mem(VM_MEM_RESIDENT) >= PAGE_CNT, "pages freed");
+
+    heap = sbrk(PAGE_CNT * PAGE_SIZE);
+    for (i = 0; i < PAGE_CNT * PAGE_SIZE; i++)
+        if (heap[i] != 0)
+            fail("byte %d of regrown heap is %d", i, heap[i]);
+    msg("regrown heap reads as zeros");
+
+    CHECK(sbrk(-2 * PAGE_CNT * PAGE_SIZE) == NULL, "cannot shrink below start");
+    CHECK(sbrk(0x7fffffff) == NULL, "cannot grow into the stack");
+}
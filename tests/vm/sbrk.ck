@@ -0,0 +1,17 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected (IGNORE_EXIT_CODES => 1, [<<'EOF']);
+(sbrk) begin
+(sbrk) sbrk(0) returns the break
+(sbrk) sbrk returns the old break
+(sbrk) break moved
+(sbrk) shrink heap
+(sbrk) pages freed
+(sbrk) regrown heap reads as zeros
+(sbrk) cannot shrink below start
+(sbrk) cannot grow into the stack
+(sbrk) end
+EOF
+pass;
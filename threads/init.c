@@ -148,21 +148,37 @@ static void paging_init(uint64_t mem_end) {
     pml4 = base_pml4 = palloc_get_page(PAL_ASSERT | PAL_ZERO);
 
     extern char start, _end_kernel_text;
+    uint64_t text_start = (uint64_t)&start, text_end = (uint64_t)&_end_kernel_text;
     // Maps physical address [0 ~ mem_end] to
     //   [LOADER_KERN_BASE ~ LOADER_KERN_BASE + mem_end].
-    for (uint64_t pa = 0; pa < mem_end; pa += PGSIZE) {
+    // Each 2 MB block is mapped with one huge page, unless it is cut
+    // short by mem_end or only partly holds the read-only kernel text;
+    // those get 4 kB pages.  (1 GB pages would need KERN_BASE to be
+    // 1 GB aligned, which it is not.)
+    for (uint64_t pa = 0; pa < mem_end;) {
         uint64_t va = (uint64_t)ptov(pa);
+        bool uniform = va + HPGSIZE <= text_start || va >= text_end ||
+                       (text_start <= va && va + HPGSIZE <= text_end);
 
-        perm = PTE_P | PTE_W;
-        if ((uint64_t)&start <= va && va < (uint64_t)&_end_kernel_text)
+        perm = PTE_P | PTE_W | PTE_G;
+        if (text_start <= va && va < text_end)
             perm &= ~PTE_W;
 
+        if (pa % HPGSIZE == 0 && pa + HPGSIZE <= mem_end && uniform) {
+            if ((pte = pml4e_walk_pde(pml4, va, 1)) != NULL)
+                *pte = pa | PTE_PS | perm;
+            pa += HPGSIZE;
+            continue;
+        }
+
         if ((pte = pml4e_walk(pml4, va, 1)) != NULL)
             *pte = pa | perm;
+        pa += PGSIZE;
     }
 
     // reload cr3
     pml4_activate(0);
+    pml4_tlb_init();
 }
 
 /* Breaks the kernel command line into words and returns them as
@@ -222,6 +238,10 @@ static char **parse_options(char **argv) {
             user_page_limit = atoi(value);
         else if (!strcmp(name, "-threads-tests"))
             thread_tests = true;
+#endif
+#ifdef VM
+        else if (!strcmp(name, "-fa"))
+            fault_around_pages = atoi(value);
 #endif
         else
             PANIC("unknown option `%s' (use -h for help)", name);
@@ -318,6 +338,9 @@ static void usage(void) {
         "  -mlfqs             Use multi-level feedback queue scheduler.\n"
 #ifdef USERPROG
         "  -ul=COUNT          Limit user memory to COUNT pages.\n"
+#endif
+#ifdef VM
+        "  -fa=COUNT          Populate up to COUNT pages per file-backed fault.\n"
 #endif
     );
     power_off();
@@ -349,4 +372,7 @@ static void print_stats(void) {
 #ifdef USERPROG
     exception_print_stats();
 #endif
+#ifdef VM
+    vm_print_stats();
+#endif
 }
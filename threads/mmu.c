@@ -6,14 +6,90 @@
 
 #include "intrinsic.h"
 #include "threads/init.h"
+#include "threads/interrupt.h"
 #include "threads/palloc.h"
 #include "threads/pte.h"
 #include "threads/thread.h"
 
-static uint64_t *pgdir_walk(uint64_t *pdp, const uint64_t va, int create) {
+/* Process-context identifiers.
+ * With CR4.PCIDE set, the CPU tags TLB entries with the PCID in the
+ * low bits of CR3, so that switching address spaces does not flush
+ * them.  base_pml4 uses PCID 0; a process pml4 uses the PCID picked by
+ * pml4_pcid(), which may be shared with other pml4s.  PCID_OWNER[N] is
+ * the pml4 whose entries PCID N may hold; a pml4 that finds another
+ * owner, or none, flushes the PCID as it takes it over.  Clearing the
+ * owner is thus how entries of an inactive address space are thrown
+ * away when INVPCID is not there to drop them one by one. */
+#define PCID_CNT 4096
+#define CR3_NOFLUSH (1ULL << 63)
+#define CR4_PGE (1 << 7)
+#define CR4_PCIDE (1 << 17)
+#define INVPCID_ADDR 0
+#define INVPCID_CONTEXT 1
+static bool pcid_enabled, invpcid_enabled;
+static uint64_t *pcid_owner[PCID_CNT];
+
+/* Page tables set aside for splitting huge pages, linked through their
+ * first word: one for each huge page mapped, taken when it is mapped.
+ * Splits come from eviction, copy-on-write and munmap, all of which
+ * run exactly when memory is short, so they must not allocate. */
+static void *split_reserve;
+
+static uint64_t pml4_pcid(uint64_t *pml4);
+static void tlb_invalidate(uint64_t *pml4, const uint64_t va);
+static void tlb_flush(uint64_t *pml4);
+static void tlb_batch_add(struct tlb_batch *batch, uint64_t *pml4, const uint64_t va);
+
+/* Adds PT, a page, to the split reserve. */
+static void split_reserve_put(void *pt) {
+    enum intr_level old_level = intr_disable();
+    *(void **)pt = split_reserve;
+    split_reserve = pt;
+    intr_set_level(old_level);
+}
+
+/* Takes a page from the split reserve, on behalf of a huge page that is
+ * going away.  There is always one. */
+static void *split_reserve_take(void) {
+    enum intr_level old_level = intr_disable();
+    void *pt = split_reserve;
+
+    ASSERT(pt != NULL);
+    split_reserve = *(void **)pt;
+    intr_set_level(old_level);
+    return pt;
+}
+
+/* Replaces the huge page mapping in PDE of PML4, which covers VA, with
+ * a page table from the split reserve that maps the same frames with
+ * the same permissions, 4 kB at a time. */
+static void pde_split(uint64_t *pml4, uint64_t *pde, const uint64_t va) {
+    uint64_t *pt = split_reserve_take();
+    uint64_t pa = PTE_ADDR(*pde);
+    uint64_t flags = *pde & PTE_FLAGS & ~PTE_PS;
+
+    for (unsigned i = 0; i < PGSIZE / sizeof(uint64_t *); i++)
+        pt[i] = (pa + i * PGSIZE) | flags;
+    *pde = vtop(pt) | PTE_U | PTE_W | PTE_P;
+
+    /* INVLPG only reaches the active PCID, so a PML4 that is not the
+     * one loaded needs its own invalidation. */
+    tlb_invalidate(pml4, va);
+}
+
+/* Returns the entry that maps VA in page directory PDP of PML4.  If a
+ * huge page maps VA, that is its PDE, unless CREATE is set, in which
+ * case the huge page is split first. */
+static uint64_t *pgdir_walk(uint64_t *pml4, uint64_t *pdp, const uint64_t va, int create) {
     int idx = PDX(va);
     if (pdp) {
         uint64_t *pte = (uint64_t *)pdp[idx];
+        if (((uint64_t)pte & PTE_P) && ((uint64_t)pte & PTE_PS)) {
+            if (!create)
+                return &pdp[idx];
+            pde_split(pml4, &pdp[idx], va);
+            pte = (uint64_t *)pdp[idx];
+        }
         if (!((uint64_t)pte & PTE_P)) {
             if (create) {
                 uint64_t *new_page = palloc_get_page(PAL_ZERO);
@@ -29,7 +105,7 @@ static uint64_t *pgdir_walk(uint64_t *pdp, const uint64_t va, int create) {
     return NULL;
 }
 
-static uint64_t *pdpe_walk(uint64_t *pdpe, const uint64_t va, int create) {
+static uint64_t *pdpe_walk(uint64_t *pml4, uint64_t *pdpe, const uint64_t va, int create) {
     uint64_t *pte = NULL;
     int idx = PDPE(va);
     int allocated = 0;
@@ -46,7 +122,7 @@ static uint64_t *pdpe_walk(uint64_t *pdpe, const uint64_t va, int create) {
             } else
                 return NULL;
         }
-        pte = pgdir_walk(ptov(PTE_ADDR(pdpe[idx])), va, create);
+        pte = pgdir_walk(pml4, ptov(PTE_ADDR(pdpe[idx])), va, create);
     }
     if (pte == NULL && allocated) {
         palloc_free_page((void *)ptov(PTE_ADDR(pdpe[idx])));
@@ -60,7 +136,10 @@ static uint64_t *pdpe_walk(uint64_t *pdpe, const uint64_t va, int create) {
  * If PML4E does not have a page table for VADDR, behavior depends
  * on CREATE.  If CREATE is true, then a new page table is
  * created and a pointer into it is returned.  Otherwise, a null
- * pointer is returned. */
+ * pointer is returned.
+ * If VADDR lies in a huge page, the entry returned without CREATE is
+ * the PDE that maps all of it, with PTE_PS set; with CREATE, the huge
+ * page is split into 4 kB pages first. */
 uint64_t *pml4e_walk(uint64_t *pml4e, const uint64_t va, int create) {
     uint64_t *pte = NULL;
     int idx = PML4(va);
@@ -78,7 +157,7 @@ uint64_t *pml4e_walk(uint64_t *pml4e, const uint64_t va, int create) {
             } else
                 return NULL;
         }
-        pte = pdpe_walk(ptov(PTE_ADDR(pml4e[idx])), va, create);
+        pte = pdpe_walk(pml4e, ptov(PTE_ADDR(pml4e[idx])), va, create);
     }
     if (pte == NULL && allocated) {
         palloc_free_page((void *)ptov(PTE_ADDR(pml4e[idx])));
@@ -87,6 +166,39 @@ uint64_t *pml4e_walk(uint64_t *pml4e, const uint64_t va, int create) {
     return pte;
 }
 
+/* Like pml4e_walk() without CREATE, except that a huge page holding
+ * VA is split first, so that the entry returned covers the 4 kB page
+ * at VA alone.  Used before changing a single page's mapping. */
+static uint64_t *pml4e_walk_split(uint64_t *pml4, const uint64_t va) {
+    uint64_t *pte = pml4e_walk(pml4, va, 0);
+
+    if (pte != NULL && (*pte & PTE_PS)) {
+        pde_split(pml4, pte, va);
+        pte = pml4e_walk(pml4, va, 0);
+    }
+    return pte;
+}
+
+/* Returns the page directory entry for VA in PML4, for mapping a huge
+ * page there.  The tables above it are created if missing and CREATE
+ * is set; otherwise, or if memory is short, returns a null pointer. */
+uint64_t *pml4e_walk_pde(uint64_t *pml4, const uint64_t va, int create) {
+    uint64_t *table = pml4;
+    unsigned idx[] = {PML4(va), PDPE(va)};
+
+    for (int level = 0; level < 2; level++) {
+        uint64_t *entry = &table[idx[level]];
+        if (!(*entry & PTE_P)) {
+            uint64_t *new_page = create ? palloc_get_page(PAL_ZERO) : NULL;
+            if (new_page == NULL)
+                return NULL;
+            *entry = vtop(new_page) | PTE_U | PTE_W | PTE_P;
+        }
+        table = ptov(PTE_ADDR(*entry));
+    }
+    return &table[PDX(va)];
+}
+
 /* Creates a new page map level 4 (pml4) has mappings for kernel
  * virtual addresses, but none for user virtual addresses.
  * Returns the new page directory, or a null pointer if memory
@@ -115,11 +227,13 @@ static bool pt_for_each(uint64_t *pt, pte_for_each_func *func, void *aux, unsign
     return true;
 }
 
+/* Huge pages are skipped: they only map user memory that the VM
+ * subsystem tracks page by page. */
 static bool pgdir_for_each(uint64_t *pdp, pte_for_each_func *func, void *aux, unsigned pml4_index,
                            unsigned pdp_index) {
     for (unsigned i = 0; i < PGSIZE / sizeof(uint64_t *); i++) {
         uint64_t *pte = ptov((uint64_t *)pdp[i]);
-        if (((uint64_t)pte) & PTE_P)
+        if ((((uint64_t)pte) & PTE_P) && !(((uint64_t)pte) & PTE_PS))
             if (!pt_for_each((uint64_t *)PTE_ADDR(pte), func, aux, pml4_index, pdp_index, i))
                 return false;
     }
@@ -156,11 +270,15 @@ static void pt_destroy(uint64_t *pt) {
     palloc_free_page((void *)pt);
 }
 
+/* Frames of huge pages belong to the VM subsystem, which frees them;
+ * the page tables reserved for splitting them are freed here. */
 static void pgdir_destroy(uint64_t *pdp) {
     for (unsigned i = 0; i < PGSIZE / sizeof(uint64_t *); i++) {
         uint64_t *pte = ptov((uint64_t *)pdp[i]);
-        if (((uint64_t)pte) & PTE_P)
+        if ((((uint64_t)pte) & PTE_P) && !(((uint64_t)pte) & PTE_PS))
             pt_destroy(PTE_ADDR(pte));
+        else if ((((uint64_t)pte) & PTE_P) && (((uint64_t)pte) & PTE_PS))
+            palloc_free_page(split_reserve_take());
     }
     palloc_free_page((void *)pdp);
 }
@@ -180,6 +298,11 @@ void pml4_destroy(uint64_t *pml4) {
         return;
     ASSERT(pml4 != base_pml4);
 
+    /* A pml4 later allocated in the same page must not inherit our
+     * TLB entries. */
+    if (pcid_owner[pml4_pcid(pml4)] == pml4)
+        pcid_owner[pml4_pcid(pml4)] = NULL;
+
     /* if PML4 (vaddr) >= 1, it's kernel space by define. */
     uint64_t *pdpe = ptov((uint64_t *)pml4[0]);
     if (((uint64_t)pdpe) & PTE_P)
@@ -187,10 +310,120 @@ void pml4_destroy(uint64_t *pml4) {
     palloc_free_page((void *)pml4);
 }
 
+/* Turns on global kernel pages, and PCIDs if the CPU has them.
+ * Called once base_pml4, whose kernel mappings are marked global, is
+ * active. */
+void pml4_tlb_init(void) {
+    uint32_t eax, ebx, ecx, edx;
+
+    lcr4(rcr4() | CR4_PGE);
+
+    cpuid(1, 0, &eax, &ebx, &ecx, &edx);
+    if (!(ecx & (1 << 17)))
+        return;
+    pcid_enabled = true;
+    pcid_owner[0] = base_pml4;
+    lcr4(rcr4() | CR4_PCIDE);
+
+    cpuid(0, 0, &eax, &ebx, &ecx, &edx);
+    if (eax >= 7) {
+        cpuid(7, 0, &eax, &ebx, &ecx, &edx);
+        invpcid_enabled = (ebx & (1 << 10)) != 0;
+    }
+}
+
 /* Loads page directory PD into the CPU's page directory base
- * register. */
+ * register.  With PCIDs, the TLB entries of the address space being
+ * left are kept, and those of PML4 are reused if still valid. */
 void pml4_activate(uint64_t *pml4) {
-    lcr3(vtop(pml4 ? pml4 : base_pml4));
+    if (pml4 == NULL)
+        pml4 = base_pml4;
+    if (PTE_ADDR(rcr3()) == vtop(pml4))
+        return;
+    if (!pcid_enabled) {
+        lcr3(vtop(pml4));
+        return;
+    }
+
+    uint64_t pcid = pml4_pcid(pml4);
+    if (pcid_owner[pcid] == pml4)
+        lcr3(vtop(pml4) | pcid | CR3_NOFLUSH);
+    else {
+        pcid_owner[pcid] = pml4;
+        lcr3(vtop(pml4) | pcid);
+    }
+}
+
+/* Returns the PCID for PML4. */
+static uint64_t pml4_pcid(uint64_t *pml4) {
+    if (pml4 == base_pml4)
+        return 0;
+    return pg_no(vtop(pml4)) % (PCID_CNT - 1) + 1;
+}
+
+/* Invalidates the TLB entries for VA in address space PML4, after its
+ * mapping changed.  Entries of an inactive address space only exist
+ * with PCIDs, since loading CR3 otherwise flushes them. */
+static void tlb_invalidate(uint64_t *pml4, const uint64_t va) {
+    if (PTE_ADDR(rcr3()) == vtop(pml4))
+        invlpg(va);
+    else if (pcid_enabled) {
+        uint64_t pcid = pml4_pcid(pml4);
+        if (pcid_owner[pcid] != pml4)
+            return;
+        if (invpcid_enabled)
+            invpcid(INVPCID_ADDR, pcid, va);
+        else
+            pcid_owner[pcid] = NULL;
+    }
+}
+
+/* Invalidates every non-global TLB entry of address space PML4.  For
+ * the active one that means reloading CR3: without the no-flush bit,
+ * that drops the entries of its PCID, or of all but the global pages
+ * if PCIDs are off. */
+static void tlb_flush(uint64_t *pml4) {
+    if (PTE_ADDR(rcr3()) == vtop(pml4))
+        lcr3(rcr3());
+    else if (pcid_enabled) {
+        uint64_t pcid = pml4_pcid(pml4);
+        if (pcid_owner[pcid] != pml4)
+            return;
+        if (invpcid_enabled)
+            invpcid(INVPCID_CONTEXT, pcid, 0);
+        else
+            pcid_owner[pcid] = NULL;
+    }
+}
+
+/* Initializes BATCH with no invalidations pending. */
+void tlb_batch_init(struct tlb_batch *batch) {
+    batch->pml4 = NULL;
+    batch->cnt = 0;
+}
+
+/* Notes in BATCH that the TLB entry for VA in PML4 is stale.  A batch
+ * covers one address space; one for another is flushed first. */
+static void tlb_batch_add(struct tlb_batch *batch, uint64_t *pml4, const uint64_t va) {
+    if (batch->pml4 != pml4) {
+        tlb_batch_flush(batch);
+        batch->pml4 = pml4;
+    }
+    if (batch->cnt < TLB_BATCH_PAGES)
+        batch->va[batch->cnt] = va;
+    batch->cnt++;
+}
+
+/* Carries out the invalidations pending in BATCH: one INVLPG per page
+ * for up to TLB_BATCH_PAGES pages, past which flushing the whole
+ * address space is cheaper than walking it page by page. */
+void tlb_batch_flush(struct tlb_batch *batch) {
+    if (batch->cnt > TLB_BATCH_PAGES)
+        tlb_flush(batch->pml4);
+    else
+        for (size_t i = 0; i < batch->cnt; i++)
+            tlb_invalidate(batch->pml4, batch->va[i]);
+    batch->cnt = 0;
 }
 
 /* Looks up the physical address that corresponds to user virtual
@@ -203,13 +436,14 @@ void *pml4_get_page(uint64_t *pml4, const void *uaddr) {
     uint64_t *pte = pml4e_walk(pml4, (uint64_t)uaddr, 0);
 
     if (pte && (*pte & PTE_P))
-        return ptov(PTE_ADDR(*pte)) + pg_ofs(uaddr);
+        return ptov(PTE_ADDR(*pte)) +
+               ((*pte & PTE_PS) ? (uint64_t)uaddr % HPGSIZE : pg_ofs(uaddr));
     return NULL;
 }
 
 /* Adds a mapping in page map level 4 PML4 from user virtual page
  * UPAGE to the physical frame identified by kernel virtual address KPAGE.
- * UPAGE must not already be mapped. KPAGE should probably be a page obtained
+ * An existing mapping for UPAGE is replaced. KPAGE should probably be a page obtained
  * from the user pool with palloc_get_page().
  * If WRITABLE is true, the new page is read/write;
  * otherwise it is read-only.
@@ -223,11 +457,56 @@ bool pml4_set_page(uint64_t *pml4, void *upage, void *kpage, bool rw) {
 
     uint64_t *pte = pml4e_walk(pml4, (uint64_t)upage, 1);
 
-    if (pte)
+    if (pte) {
         *pte = vtop(kpage) | PTE_P | (rw ? PTE_W : 0) | PTE_U;
+        tlb_invalidate(pml4, (uint64_t)upage);
+    }
     return pte != NULL;
 }
 
+/* Maps the HPGSIZE bytes of user virtual memory at UPAGE to the
+ * physically contiguous frames at kernel virtual address KPAGE with a
+ * single page directory entry.  Both must be HPGSIZE aligned, and
+ * nothing in the range may be mapped.  Later changes to the mapping of
+ * any 4 kB page inside split it back into a page table, for which one
+ * page table is put aside here.
+ * Returns true if successful, false if memory allocation failed or
+ * part of the range is mapped. */
+bool pml4_set_huge_page(uint64_t *pml4, void *upage, void *kpage, bool rw) {
+    ASSERT((uint64_t)upage % HPGSIZE == 0);
+    ASSERT(vtop(kpage) % HPGSIZE == 0);
+    ASSERT(is_user_vaddr(upage) && is_user_vaddr(upage + HPGSIZE - 1));
+    ASSERT(pml4 != base_pml4);
+
+    uint64_t *pde = pml4e_walk_pde(pml4, (uint64_t)upage, 1);
+    if (pde == NULL)
+        return false;
+
+    /* A page table left over from earlier mappings must be empty; it
+     * becomes the one reserved for splitting. */
+    uint64_t *pt;
+    if (*pde & PTE_P) {
+        if (*pde & PTE_PS)
+            return false;
+        pt = ptov(PTE_ADDR(*pde));
+        for (unsigned i = 0; i < PGSIZE / sizeof(uint64_t *); i++)
+            if (pt[i] & PTE_P)
+                return false;
+    } else if ((pt = palloc_get_page(0)) == NULL)
+        return false;
+
+    *pde = vtop(kpage) | PTE_PS | PTE_P | (rw ? PTE_W : 0) | PTE_U;
+    split_reserve_put(pt);
+    tlb_invalidate(pml4, (uint64_t)upage);
+    return true;
+}
+
+/* Returns true if VPAGE in PML4 is mapped by a huge page. */
+bool pml4_is_huge(uint64_t *pml4, const void *vpage) {
+    uint64_t *pde = pml4e_walk_pde(pml4, (uint64_t)vpage, 0);
+    return pde != NULL && (*pde & (PTE_P | PTE_PS)) == (PTE_P | PTE_PS);
+}
+
 /* Marks user virtual page UPAGE "not present" in page
  * directory PD.  Later accesses to the page will fault.  Other
  * bits in the page table entry are preserved.
@@ -237,15 +516,79 @@ void pml4_clear_page(uint64_t *pml4, void *upage) {
     ASSERT(pg_ofs(upage) == 0);
     ASSERT(is_user_vaddr(upage));
 
-    pte = pml4e_walk(pml4, (uint64_t)upage, false);
+    pte = pml4e_walk_split(pml4, (uint64_t)upage);
 
     if (pte != NULL && (*pte & PTE_P) != 0) {
         *pte &= ~PTE_P;
-        if (rcr3() == vtop(pml4))
-            invlpg((uint64_t)upage);
+        tlb_invalidate(pml4, (uint64_t)upage);
     }
 }
 
+/* Like pml4_clear_page(), except that the TLB entry for UPAGE is left
+ * for BATCH to invalidate.  Until tlb_batch_flush(), the CPU may still
+ * use the old mapping, so the frame must not be reused before then. */
+void pml4_unmap_page(uint64_t *pml4, void *upage, struct tlb_batch *batch) {
+    uint64_t *pte;
+    ASSERT(pg_ofs(upage) == 0);
+    ASSERT(is_user_vaddr(upage));
+
+    pte = pml4e_walk_split(pml4, (uint64_t)upage);
+
+    if (pte != NULL && (*pte & PTE_P) != 0) {
+        *pte &= ~PTE_P;
+        tlb_batch_add(batch, pml4, (uint64_t)upage);
+    }
+}
+
+/* Marks every page mapped in [START, END) of PML4 "not present", as
+ * pml4_clear_page() does, leaving the TLB invalidations to BATCH.
+ * Tables that are not there are skipped whole, so the cost follows
+ * what is mapped rather than the size of the range.  A huge page that
+ * lies wholly inside the range is cleared with its single entry; one
+ * that straddles an end is split first.  Returns the number of 4 kB
+ * pages unmapped. */
+size_t pml4_unmap_range(uint64_t *pml4, void *start, void *end, struct tlb_batch *batch) {
+    uint64_t va = (uint64_t)start;
+    size_t cnt = 0;
+
+    ASSERT(pg_ofs(start) == 0 && pg_ofs(end) == 0);
+    ASSERT(start <= end && (uint64_t)end <= KERN_BASE);
+
+    while (va < (uint64_t)end) {
+        /* Walk down as far as the tables go.  SPAN is the size of the
+         * region that ENTRY maps. */
+        uint64_t *entry = &pml4[PML4(va)];
+        uint64_t span = 1ULL << PML4SHIFT;
+        if (*entry & PTE_P) {
+            entry = (uint64_t *)ptov(PTE_ADDR(*entry)) + PDPE(va);
+            span = 1ULL << PDPESHIFT;
+        }
+        if (span == 1ULL << PDPESHIFT && (*entry & PTE_P)) {
+            entry = (uint64_t *)ptov(PTE_ADDR(*entry)) + PDX(va);
+            span = HPGSIZE;
+        }
+        if (span == HPGSIZE && (*entry & (PTE_P | PTE_PS)) == PTE_P) {
+            entry = (uint64_t *)ptov(PTE_ADDR(*entry)) + PTX(va);
+            span = PGSIZE;
+        }
+
+        uint64_t next = (va & ~(span - 1)) + span;
+        if (*entry & PTE_P) {
+            if (span == HPGSIZE && (va % HPGSIZE != 0 || next > (uint64_t)end)) {
+                pde_split(pml4, entry, va);
+                continue;
+            }
+            if (span == HPGSIZE)
+                palloc_free_page(split_reserve_take());
+            *entry &= ~PTE_P;
+            tlb_batch_add(batch, pml4, va);
+            cnt += span / PGSIZE;
+        }
+        va = next;
+    }
+    return cnt;
+}
+
 /* Returns true if the PTE for virtual page VPAGE in PML4 is dirty,
  * that is, if the page has been modified since the PTE was
  * installed.
@@ -255,18 +598,38 @@ bool pml4_is_dirty(uint64_t *pml4, const void *vpage) {
     return pte != NULL && (*pte & PTE_D) != 0;
 }
 
+/* Returns true if the PTE for virtual page VPAGE in PML4 is present
+ * and writable.  Returns false if PML4 contains no PTE for VPAGE. */
+bool pml4_is_writable(uint64_t *pml4, const void *vpage) {
+    uint64_t *pte = pml4e_walk(pml4, (uint64_t)vpage, false);
+    return pte != NULL && (*pte & (PTE_P | PTE_W)) == (PTE_P | PTE_W);
+}
+
 /* Set the dirty bit to DIRTY in the PTE for virtual page VPAGE
  * in PML4. */
 void pml4_set_dirty(uint64_t *pml4, const void *vpage, bool dirty) {
-    uint64_t *pte = pml4e_walk(pml4, (uint64_t)vpage, false);
+    uint64_t *pte = pml4e_walk_split(pml4, (uint64_t)vpage);
     if (pte) {
         if (dirty)
             *pte |= PTE_D;
         else
             *pte &= ~(uint32_t)PTE_D;
 
-        if (rcr3() == vtop(pml4))
-            invlpg((uint64_t)vpage);
+        tlb_invalidate(pml4, (uint64_t)vpage);
+    }
+}
+
+/* Sets the writable bit to WRITABLE in the PTE for virtual page
+ * VPAGE in PML4.  Used to write-protect pages shared copy-on-write. */
+void pml4_set_writable(uint64_t *pml4, const void *vpage, bool writable) {
+    uint64_t *pte = pml4e_walk_split(pml4, (uint64_t)vpage);
+    if (pte) {
+        if (writable)
+            *pte |= PTE_W;
+        else
+            *pte &= ~(uint64_t)PTE_W;
+
+        tlb_invalidate(pml4, (uint64_t)vpage);
     }
 }
 
@@ -280,7 +643,8 @@ bool pml4_is_accessed(uint64_t *pml4, const void *vpage) {
 }
 
 /* Sets the accessed bit to ACCESSED in the PTE for virtual page
-   VPAGE in PD. */
+   VPAGE in PD.  For a huge page, that is the bit shared by all of
+   it; the page is not split just for this. */
 void pml4_set_accessed(uint64_t *pml4, const void *vpage, bool accessed) {
     uint64_t *pte = pml4e_walk(pml4, (uint64_t)vpage, false);
     if (pte) {
@@ -289,7 +653,6 @@ void pml4_set_accessed(uint64_t *pml4, const void *vpage, bool accessed) {
         else
             *pte &= ~(uint32_t)PTE_A;
 
-        if (rcr3() == vtop(pml4))
-            invlpg((uint64_t)vpage);
+        tlb_invalidate(pml4, (uint64_t)vpage);
     }
 }
@@ -10,6 +10,7 @@
 #include <string.h>
 
 #include "threads/init.h"
+#include "threads/interrupt.h"
 #include "threads/loader.h"
 #include "threads/synch.h"
 #include "threads/vaddr.h"
@@ -33,6 +34,7 @@ struct pool {
     struct lock lock;        /* Mutual exclusion. */
     struct bitmap *used_map; /* Bitmap of free pages. */
     uint8_t *base;           /* Base of pool. */
+    size_t free_cnt;         /* Number of free pages. */
 };
 
 /* Two pools: one for kernel data, one for user pages. */
@@ -43,6 +45,7 @@ size_t user_page_limit = SIZE_MAX;
 static void init_pool(struct pool *p, void **bm_base, uint64_t start, uint64_t end);
 
 static bool page_from_pool(const struct pool *, void *page);
+static void adjust_free_cnt(struct pool *, size_t add, size_t sub);
 
 /* multiboot info */
 struct multiboot_info {
@@ -219,11 +222,13 @@ static void populate_pools(struct area *base_mem, struct area *ext_mem) {
             if ((uint64_t)pool_end < end) {
                 page_cnt = ((uint64_t)pool_end - start) / PGSIZE;
                 bitmap_set_multiple(pool->used_map, page_idx, page_cnt, false);
+                pool->free_cnt += page_cnt;
                 start = (uint64_t)pool_end;
                 goto split;
             } else {
                 page_cnt = ((uint64_t)end - start) / PGSIZE;
                 bitmap_set_multiple(pool->used_map, page_idx, page_cnt, false);
+                pool->free_cnt += page_cnt;
             }
         }
     }
@@ -261,9 +266,10 @@ void *palloc_get_multiple(enum palloc_flags flags, size_t page_cnt) {
     lock_release(&pool->lock);
     void *pages;
 
-    if (page_idx != BITMAP_ERROR)
+    if (page_idx != BITMAP_ERROR) {
         pages = pool->base + PGSIZE * page_idx;
-    else
+        adjust_free_cnt(pool, 0, page_cnt);
+    } else
         pages = NULL;
 
     if (pages) {
@@ -277,6 +283,37 @@ void *palloc_get_multiple(enum palloc_flags flags, size_t page_cnt) {
     return pages;
 }
 
+/* Obtains PAGE_CNT contiguous free pages like
+   palloc_get_multiple(), except that the physical address of the
+   first one is a multiple of ALIGN bytes, which must be a multiple of
+   PGSIZE.  Used to back huge page mappings. */
+void *palloc_get_multiple_aligned(enum palloc_flags flags, size_t page_cnt, size_t align) {
+    struct pool *pool = flags & PAL_USER ? &user_pool : &kernel_pool;
+    size_t step = align / PGSIZE;
+    size_t pool_cnt = bitmap_size(pool->used_map);
+    size_t page_idx = (align - vtop(pool->base) % align) % align / PGSIZE;
+    void *pages = NULL;
+
+    ASSERT(align % PGSIZE == 0);
+    lock_acquire(&pool->lock);
+    for (; page_idx + page_cnt <= pool_cnt; page_idx += step) {
+        if (bitmap_none(pool->used_map, page_idx, page_cnt)) {
+            bitmap_set_multiple(pool->used_map, page_idx, page_cnt, true);
+            pages = pool->base + PGSIZE * page_idx;
+            break;
+        }
+    }
+    lock_release(&pool->lock);
+
+    if (pages != NULL) {
+        adjust_free_cnt(pool, 0, page_cnt);
+        if (flags & PAL_ZERO)
+            memset(pages, 0, PGSIZE * page_cnt);
+    } else if (flags & PAL_ASSERT)
+        PANIC("palloc_get: out of pages");
+    return pages;
+}
+
 /* Obtains a single free page and returns its kernel virtual
    address.
    If PAL_USER is set, the page is obtained from the user pool,
@@ -311,6 +348,7 @@ void palloc_free_multiple(void *pages, size_t page_cnt) {
 #endif
     ASSERT(bitmap_all(pool->used_map, page_idx, page_cnt));
     bitmap_set_multiple(pool->used_map, page_idx, page_cnt, false);
+    adjust_free_cnt(pool, page_cnt, 0);
 }
 
 /* Frees the page at PAGE. */
@@ -329,6 +367,7 @@ static void init_pool(struct pool *p, void **bm_base, uint64_t start, uint64_t e
     lock_init(&p->lock);
     p->used_map = bitmap_create_in_buf(pgcnt, *bm_base, bm_pages);
     p->base = (void *)start;
+    p->free_cnt = 0;
 
     // Mark all to unusable.
     bitmap_set_all(p->used_map, true);
@@ -336,6 +375,29 @@ static void init_pool(struct pool *p, void **bm_base, uint64_t start, uint64_t e
     *bm_base += bm_pages;
 }
 
+/* Stores in *BASE the kernel virtual address of the first page of the
+   user pool, and in *PAGE_CNT the number of pages it spans. */
+void palloc_user_range(void **base, size_t *page_cnt) {
+    *base = user_pool.base;
+    *page_cnt = bitmap_size(user_pool.used_map);
+}
+
+/* Returns the number of free pages in the user pool if PAL_USER is set
+   in FLAGS, otherwise in the kernel pool. */
+size_t palloc_free_cnt(enum palloc_flags flags) {
+    return (flags & PAL_USER ? &user_pool : &kernel_pool)->free_cnt;
+}
+
+/* Adds ADD to, and subtracts SUB from, the free page count of POOL.
+   Pages are freed without the pool lock held (even from the
+   scheduler, for dying threads' stacks), so the update is made
+   atomic by turning interrupts off instead. */
+static void adjust_free_cnt(struct pool *pool, size_t add, size_t sub) {
+    enum intr_level old_level = intr_disable();
+    pool->free_cnt = pool->free_cnt + add - sub;
+    intr_set_level(old_level);
+}
+
 /* Returns true if PAGE was allocated from POOL,
    false otherwise. */
 static bool page_from_pool(const struct pool *pool, void *page) {
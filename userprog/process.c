@@ -47,6 +47,8 @@ static void process_cleanup(void);
 static bool load(const char *file_name, char *args, struct intr_frame *if_);
 static void initd(void *f_name);
 static void __do_fork(void *);
+static void __do_spawn(void *);
+static bool duplicate_fdt(struct thread *parent);
 static uint64_t *push_stack(char *arg, size_t size, struct intr_frame *if_);
 static uint64_t *pop_stack(size_t size, struct intr_frame *if_);
 
@@ -66,6 +68,16 @@ struct init_data {
     const char *file_name;
 };
 
+/* Hands a command line from process_spawn() to the child, and the
+ * child's verdict back.  Lives on the parent's stack, which the child
+ * must not touch once it ups DONE. */
+struct spawn_data {
+    struct thread *parent;
+    char *cmd_line;        /* Page holding a copy of the command line. */
+    struct semaphore done; /* Upped once the child is set up or gone. */
+    bool success;          /* Whether the child got as far as load(). */
+};
+
 
 
 /* General process initializer for initd and other process. */
@@ -272,6 +284,32 @@ static void __do_fork(void *aux) {
      * TODO:       from the fork() until this function successfully duplicates
      * TODO:       the resources of parent.*/
     // 부모의 파일 디스크립터 테이블 복사
+    if (!duplicate_fdt(parent))
+        goto error;
+
+    process_init();
+
+    free(fork_data);
+    if_.R.rax = 0;  // 자식 rax 초기화
+
+    /* Finally, switch to the newly created process. */
+    if (succ) {
+        sema_up(&(current->parent->fork_sema));
+
+        do_iret(&if_);
+    }
+error:
+    free(fork_data);
+    current->exit_status = -1;
+    thread_exit();
+}
+
+/* Copies PARENT's file descriptor table into the current thread's.
+ * Returns false if memory runs out; whatever was copied is left for
+ * process_exit() to close. */
+static bool duplicate_fdt(struct thread *parent) {
+    struct thread *current = thread_current();
+
     current->fd_pg_cnt = parent->fd_pg_cnt;
     current->open_file_cnt = 0;
 
@@ -280,7 +318,7 @@ static void __do_fork(void *aux) {
         palloc_free_page(current->fdt);
         current->fdt = palloc_get_multiple(PAL_ZERO, current->fd_pg_cnt);
         if (current->fdt == NULL) {
-            goto error;
+            return false;
         }
 
         int i = 0;
@@ -288,28 +326,80 @@ static void __do_fork(void *aux) {
             if (parent->fdt[i] != NULL) {
                 current->fdt[i] = duplicate_file(parent->fdt[i]);
                 if (current->fdt[i] == NULL) {
-                    goto error;
+                    return false;
                 }
                 current->open_file_cnt++;
             }
         }
     }
+    return true;
+}
 
-    process_init();
+/* Starts a child of the current process running CMD_LINE, like fork()
+ * followed by exec() in the child, but without copying the address
+ * space that exec() would throw away: the child gets a copy of the
+ * file descriptor table only, and loads the program straight into an
+ * empty address space.  The cost is thus independent of the size of
+ * the parent.  Returns the child's thread id, or TID_ERROR if the
+ * child could not be created.  As with fork() and exec(), a program
+ * that fails to load shows up as the child exiting with -1. */
+tid_t process_spawn(const char *cmd_line) {
+    struct spawn_data data;
+    char name[sizeof thread_current()->name];
+    tid_t tid;
 
-    free(fork_data);
-    if_.R.rax = 0;  // 자식 rax 초기화
+    data.parent = thread_current();
+    data.cmd_line = palloc_get_page(0);
+    if (data.cmd_line == NULL)
+        return TID_ERROR;
+    strlcpy(data.cmd_line, cmd_line, PGSIZE);
+    sema_init(&data.done, 0);
+    data.success = false;
 
-    /* Finally, switch to the newly created process. */
-    if (succ) {
-        sema_up(&(current->parent->fork_sema));
+    /* The thread is named after the program, as exec() would. */
+    strlcpy(name, data.cmd_line, sizeof name);
+    name[strcspn(name, " ")] = '\0';
 
-        do_iret(&if_);
+    tid = thread_create(name, PRI_DEFAULT, __do_spawn, &data);
+    if (tid == TID_ERROR) {
+        palloc_free_page(data.cmd_line);
+        return TID_ERROR;
     }
-error:
-    free(fork_data);
-    current->exit_status = -1;
-    thread_exit();
+    sema_down(&data.done);
+    if (!data.success) {
+        /* Reap the child, which has exited already. */
+        process_wait(tid);
+        return TID_ERROR;
+    }
+    return tid;
+}
+
+/* A thread function that sets up a child for process_spawn() and
+ * execs its command line. */
+static void __do_spawn(void *aux) {
+    struct spawn_data *data = aux;
+    struct thread *current = thread_current();
+    char *cmd_line = data->cmd_line;
+
+    current->parent = data->parent;
+    list_push_back(&current->parent->childs, &current->sibling_elem);
+#ifdef VM
+    supplemental_page_table_init(&current->spt);
+    current->spt.rss_limit = data->parent->spt.rss_limit;
+#endif
+    process_init();
+
+    if (!duplicate_fdt(data->parent)) {
+        palloc_free_page(cmd_line);
+        current->exit_status = -1;
+        sema_up(&data->done);
+        thread_exit();
+    }
+    data->success = true;
+    sema_up(&data->done);
+
+    process_exec(cmd_line);
+    NOT_REACHED();
 }
 
 /* Switch the current execution context to the f_name.
@@ -583,6 +673,11 @@ static bool load(const char *file_name, char *args, struct intr_frame *if_) {
         }
     }
 
+#ifdef VM
+    /* The heap starts right past the highest segment. */
+    vm_heap_init(&t->spt);
+#endif
+
     /* Set up stack. */
     if (!setup_stack(if_))
         goto done;
@@ -872,23 +967,64 @@ static uint64_t *pop_stack(size_t size, struct intr_frame *if_) {
  * If you want to implement the function for only project 2, implement it on the
  * upper block. */
 
-static bool lazy_load_segment(struct page *page, void *aux) {
-    struct lazy_read_file *lrf = aux;
-    if (page->frame->kva == NULL) {
-        return false;
-    }
-    void* kpage = page->frame->kva;
-    file_seek(lrf->file,lrf->ofs);
-    if (file_read(lrf->file, kpage, lrf->page_read_bytes) != lrf->page_read_bytes) {
-        palloc_free_page(kpage);
+/* Reads the pages [LO, HI) of segment region VMA into BUF: the part
+ * that falls within the region's file bytes is read, the rest zeroed. */
+static bool read_segment(struct vma *vma, uint8_t *lo, uint8_t *hi, void *buf) {
+    size_t ofs = lo - (uint8_t *)vma->start;
+    size_t size = hi - lo;
+    size_t read_bytes = 0;
+
+    if (ofs < vma->read_bytes)
+        read_bytes = vma->read_bytes - ofs < size ? vma->read_bytes - ofs : size;
+
+    if (read_bytes > 0 &&
+        file_read_at(vma->file, buf, read_bytes, vma->ofs + ofs) != (off_t)read_bytes)
         return false;
-    }
-    memset(kpage + lrf->page_read_bytes, 0, lrf->page_zero_bytes);
-    
-    free(lrf);
+    memset(buf + read_bytes, 0, size - read_bytes);
     return true;
 }
 
+/* Fills PAGE from the segment region AUX.
+ *
+ * Code and data tend to be touched in runs, so rather than one fault
+ * and one small read per page, the aligned window of
+ * fault_around_pages pages around PAGE is read with a single
+ * file_read_at() and the window's untouched pages are mapped right
+ * away.  The window is clipped to the region's file bytes; pages that
+ * are all zero are still left to fault on their own.  In a region
+ * advised MADV_SEQUENTIAL the window is wider and starts at PAGE. */
+static bool lazy_load_segment(struct page *page, void *aux) {
+    struct vma *vma = aux;
+    size_t window = vm_readahead_pages(vma);
+    uint8_t *file_end = pg_round_up(vma->start + vma->read_bytes);
+    uint8_t *lo = (uint8_t *)ROUND_DOWN((uint64_t)page->va, window * PGSIZE);
+    uint8_t *hi;
+
+    if (vma->advice == MADV_SEQUENTIAL)
+        lo = page->va;
+    hi = lo + window * PGSIZE;
+    uint8_t *buf = NULL;
+
+    if (lo < (uint8_t *)vma->start)
+        lo = vma->start;
+    if (hi > file_end)
+        hi = file_end;
+    if ((uint8_t *)page->va < hi && hi - lo > PGSIZE)
+        buf = palloc_get_multiple(0, (hi - lo) / PGSIZE);
+    if (buf == NULL)
+        return read_segment(vma, page->va, (uint8_t *)page->va + PGSIZE, page->frame->kva);
+
+    bool success = read_segment(vma, lo, hi, buf);
+    if (success) {
+        memcpy(page->frame->kva, buf + ((uint8_t *)page->va - lo), PGSIZE);
+        for (uint8_t *upage = lo; upage < hi; upage += PGSIZE)
+            if (upage != page->va)
+                vm_claim_page_with(upage, buf + (upage - lo));
+    }
+    palloc_free_multiple(buf, (hi - lo) / PGSIZE);
+    return success;
+}
+
 /* Loads a segment starting at offset OFS in FILE at address
  * UPAGE.  In total, READ_BYTES + ZERO_BYTES bytes of virtual
  * memory are initialized, as follows:
@@ -902,39 +1038,24 @@ static bool lazy_load_segment(struct page *page, void *aux) {
  * user process if WRITABLE is true, read-only otherwise.
  *
  * Return true if successful, false if a memory allocation error
- * or disk read error occurs. */
+ * or disk read error occurs.
+ *
+ * Nothing is read here: the segment becomes one region, and its pages
+ * are filled by lazy_load_segment() as they are first touched. */
 static bool load_segment(struct file *file, off_t ofs, uint8_t *upage, uint32_t read_bytes,
                          uint32_t zero_bytes, bool writable) {
     ASSERT((read_bytes + zero_bytes) % PGSIZE == 0);
     ASSERT(pg_ofs(upage) == 0);
     ASSERT(ofs % PGSIZE == 0);
 
-    while (read_bytes > 0 || zero_bytes > 0) {
-        /* Do calculate how to fill this page.
-          We will read PAGE_READ_BYTES bytes from FILE
-          and zero the final PAGE_ZERO_BYTES bytes. */
-        size_t page_read_bytes = read_bytes < PGSIZE ? read_bytes : PGSIZE;
-        size_t page_zero_bytes = PGSIZE - page_read_bytes;
-
-        /* TODO: Set up aux to pass information to the lazy_load_segment. */
-        struct lazy_read_file *lrf = calloc(1, sizeof(struct lazy_read_file));
-        lrf->file = file;
-        lrf->ofs = ofs;
-        lrf->page_read_bytes = page_read_bytes;
-        lrf->page_zero_bytes = page_zero_bytes;
-
-        void *aux = lrf;
-
-        if (!vm_alloc_page_with_initializer(VM_ANON, upage, writable, lazy_load_segment, aux))
-            return false;
+    /* The region keeps its own handle, so the user closing the
+     * executable's descriptor cannot pull the file out from under it. */
+    struct file *region_file = NULL;
+    if (read_bytes > 0 && (region_file = file_reopen(file)) == NULL)
+        return false;
 
-        /* Advance. */
-        read_bytes -= page_read_bytes;
-        zero_bytes -= page_zero_bytes;
-        upage += PGSIZE;
-        ofs += page_read_bytes;
-    }
-    return true;
+    return vma_create(&thread_current()->spt, upage, upage + read_bytes + zero_bytes, VM_ANON,
+                      writable, region_file, ofs, read_bytes, lazy_load_segment) != NULL;
 }
 
 /* Create a PAGE of stack at the USER_STACK. Return true on success. */
@@ -948,11 +1069,9 @@ static bool setup_stack(struct intr_frame *if_) {
     /* TODO: 코드가 여기에 있습니다 */
     void *upage = pg_round_down(stack_bottom);
 
-    if (!vm_alloc_page_with_initializer((VM_ANON | VM_STACK), upage, true, NULL, NULL)) {
-        return false;
-    }
-    struct page *p = spt_find_page(&thread_current()->spt, upage);
-    if (p == NULL) {
+    /* The stack region grows down from here on faults. */
+    if (vma_create(&thread_current()->spt, upage, (void *)USER_STACK, VM_ANON | VM_STACK, true,
+                   NULL, 0, 0, NULL) == NULL) {
         return false;
     }
 
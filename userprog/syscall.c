@@ -25,6 +25,7 @@ static void halt_handler(void);
 static void exit_handler(int status);
 static pid_t fork_handler(const char *thread_name, struct intr_frame *f);
 static int exec_handler(const char *file);
+static pid_t spawn_handler(const char *cmd_line);
 static int wait_handler(pid_t pid);
 static bool create_handler(const char *file, unsigned initial_size);
 static bool remove_handler(const char *file);
@@ -35,6 +36,16 @@ static int write_handler(int fd, const void *buffer, unsigned size);
 static void seek_handler(int fd, unsigned position);
 static unsigned tell_handler(int fd);
 static void close_handler(int fd);
+static bool pin_user_buffer(const void *buffer, unsigned size, bool write);
+static void unpin_user_buffer(const void *buffer, unsigned size);
+#ifdef VM
+static void *mmap_handler(void *addr, size_t length, int writable, int fd, off_t offset);
+static void munmap_handler(void *addr);
+static int msync_handler(void *addr, size_t length);
+static int madvise_handler(void *addr, size_t length, int advice);
+static void rss_limit_handler(size_t pages);
+static void *sbrk_handler(intptr_t increment);
+#endif
 /* feat/syscall_handler */
 
 /* System call.
@@ -65,6 +76,9 @@ void syscall_handler(struct intr_frame *f) {
     // TODO: Your implementation goes here.
     int syscall_num = f->R.rax;
 
+#ifdef VM
+    thread_current()->user_rsp = (void *)f->rsp;
+#endif
     switch (syscall_num) {
         case SYS_HALT:  // syscall_num 0
             halt_handler();
@@ -108,6 +122,30 @@ void syscall_handler(struct intr_frame *f) {
         case SYS_CLOSE:  // syscall_num 13
             close_handler(f->R.rdi);
             break;
+        case SYS_SPAWN:
+            f->R.rax = spawn_handler((const char *)f->R.rdi);
+            break;
+#ifdef VM
+        case SYS_MMAP:
+            f->R.rax = (uint64_t)mmap_handler((void *)f->R.rdi, f->R.rsi, f->R.rdx, f->R.r10,
+                                              f->R.r8);
+            break;
+        case SYS_MUNMAP:
+            munmap_handler((void *)f->R.rdi);
+            break;
+        case SYS_MSYNC:
+            f->R.rax = msync_handler((void *)f->R.rdi, f->R.rsi);
+            break;
+        case SYS_MADVISE:
+            f->R.rax = madvise_handler((void *)f->R.rdi, f->R.rsi, f->R.rdx);
+            break;
+        case SYS_RSS_LIMIT:
+            rss_limit_handler(f->R.rdi);
+            break;
+        case SYS_SBRK:
+            f->R.rax = (uint64_t)sbrk_handler(f->R.rdi);
+            break;
+#endif
 
         default:
             printf("system call!\n");
@@ -125,7 +163,8 @@ void syscall_handler(struct intr_frame *f) {
  * https://www.notion.so/jactio/write_handler-233c9595474e804f998de012a4d9a075?source=copy_link#233c9595474e80b8bcd0e4ab9d1fa96c
  */
 static struct File *get_file_from_fd(int fd) {
-    if (get_user((thread_current()->fdt + fd)) == (int64_t)-1) {
+    if (fd < 0 || (size_t)fd >= thread_current()->fd_pg_cnt << (PGBITS - 3) ||
+        get_user((thread_current()->fdt + fd)) == (int64_t)-1) {
         return NULL;
     }
     return thread_current()->fdt[fd];
@@ -176,6 +215,16 @@ static int exec_handler(const char *file) {
     exit_handler(-1);
 }
 
+/* 자식 프로세스를 만들어 CMD_LINE 실행 (fork + exec, 주소 공간 복사 없음) */
+static pid_t spawn_handler(const char *cmd_line) {
+    if (is_user_accesable((void *)cmd_line, 0, P_USER | IS_STR)) {
+        return process_spawn(cmd_line);
+    }
+    exit_handler(-1);
+    NOT_REACHED();
+    return TID_ERROR;
+}
+
 /* 자식 프로세스가 종료될 때까지 대기 */
 static int wait_handler(pid_t pid) {
     return process_wait(pid);
@@ -230,8 +279,9 @@ static int filesize_handler(int fd) {
 static int read_handler(int fd, void *buffer, unsigned size) {
     struct File *get_file = get_file_from_fd(fd);
     int result = -1;
-    if (get_file != NULL && is_user_accesable(buffer, size, P_USER | P_WRITE)) {
+    if (get_file != NULL && pin_user_buffer(buffer, size, true)) {
         result = read_file(get_file, buffer, size);
+        unpin_user_buffer(buffer, size);
     }
     if (result == -1) {
         exit_handler(-1);
@@ -264,8 +314,9 @@ static int write_handler(int fd, const void *buffer,
 
     struct File *get_file = get_file_from_fd(fd);
     int result = -1;
-    if (get_file != NULL && is_user_accesable(buffer, size, P_USER)) {
+    if (get_file != NULL && pin_user_buffer(buffer, size, false)) {
         result = write_file(get_file, buffer, size);
+        unpin_user_buffer(buffer, size);
     }
     if (result == -1) {
         exit_handler(-1);
@@ -273,6 +324,25 @@ static int write_handler(int fd, const void *buffer,
     return result;
 }
 
+/* Checks that the process may access the SIZE bytes of user memory at
+ * BUFFER, and write them if WRITE is set.  With VM, the pages are also
+ * faulted in and pinned, all at once, so that the file system can copy
+ * to or from them in bulk; unpin_user_buffer() releases them. */
+static bool pin_user_buffer(const void *buffer, unsigned size, bool write) {
+#ifdef VM
+    return buffer != NULL && vm_pin_range(buffer, size, write);
+#else
+    return is_user_accesable((void *)buffer, size, P_USER | (write ? P_WRITE : 0));
+#endif
+}
+
+/* Releases a buffer checked by pin_user_buffer(). */
+static void unpin_user_buffer(const void *buffer UNUSED, unsigned size UNUSED) {
+#ifdef VM
+    vm_unpin_range(buffer, size);
+#endif
+}
+
 /* 파일 커서 위치 이동 */
 static void seek_handler(int fd, unsigned position) {
     struct File *get_file = get_file_from_fd(fd);
@@ -299,3 +369,41 @@ static void close_handler(int fd) {
         NOT_REACHED();
     }
 }
+
+#ifdef VM
+/* Maps the file open as FD into memory at ADDR. */
+static void *mmap_handler(void *addr, size_t length, int writable, int fd, off_t offset) {
+    struct File *file = get_file_from_fd(fd);
+
+    if (file == NULL || file->type != FILE)
+        return NULL;
+    return do_mmap(addr, length, writable, file->file_ptr, offset);
+}
+
+/* Removes the mapping that starts at ADDR. */
+static void munmap_handler(void *addr) {
+    do_munmap(addr);
+}
+
+/* Writes back the modified pages of the mappings in [ADDR, ADDR + LENGTH). */
+static int msync_handler(void *addr, size_t length) {
+    return do_msync(addr, length);
+}
+
+/* Applies the access hint ADVICE to [ADDR, ADDR + LENGTH). */
+static int madvise_handler(void *addr, size_t length, int advice) {
+    return vm_madvise(addr, length, advice);
+}
+
+/* Caps the pages the process keeps in memory at PAGES, or lifts the
+ * cap if PAGES is 0. */
+static void rss_limit_handler(size_t pages) {
+    vm_set_rss_limit(pages);
+}
+
+/* Moves the end of the heap by INCREMENT bytes and returns where it
+ * was, or NULL on failure. */
+static void *sbrk_handler(intptr_t increment) {
+    return vm_sbrk(increment);
+}
+#endif
@@ -1,13 +1,18 @@
 /* anon.c: Implementation of page for non-disk image (a.k.a. anonymous page). */
 
 #include "devices/disk.h"
+#include "threads/palloc.h"
 #include "threads/vaddr.h"
+#include "vm/swap.h"
 #include "vm/vm.h"
 /* DO NOT MODIFY BELOW LINE */
 static struct disk *swap_disk;
 static bool anon_swap_in(struct page *page, void *kva);
 static bool anon_swap_out(struct page *page);
 static void anon_destroy(struct page *page);
+static void anon_readahead(struct page *page, size_t first, const uint8_t *buf,
+                           const uint32_t *gens);
+static void anon_set_slot(struct page *page, size_t slot);
 
 /* DO NOT MODIFY this struct */
 static const struct page_operations anon_ops = {
@@ -19,8 +24,8 @@ static const struct page_operations anon_ops = {
 
 /* Initialize the data for anonymous pages */
 void vm_anon_init(void) {
-    /* TODO: Set up the swap_disk. */
-    swap_disk = NULL;
+    swap_disk = disk_get(1, 1);
+    swap_init(swap_disk);
 }
 
 /* Initialize the file mapping */
@@ -29,25 +34,155 @@ bool anon_initializer(struct page *page, enum vm_type type, void *kva) {
     page->operations = &anon_ops;
 
     struct anon_page *anon_page = &page->anon;
+    anon_page->swap_slot = SWAP_SLOT_NONE;
+    return true;
 }
 
-/* Swap in the page by read contents from the swap disk. */
+/* Swap in the page by read contents from the swap disk.
+ * The slot's whole cluster is read in one transfer, and the virtual
+ * neighbours that were swapped out into it come back with the page.
+ * Slots are released as soon as their contents are back in memory. */
 static bool anon_swap_in(struct page *page, void *kva) {
     struct anon_page *anon_page = &page->anon;
-    memset(kva, 0, PGSIZE);  // 나중에 swap_in에 맞게 함수 변경 필요
+    size_t slot = anon_page->swap_slot;
+
+    if (slot == SWAP_SLOT_NONE) {
+        memset(kva, 0, PGSIZE);
+        return true;
+    }
+
+    uint8_t *buf = palloc_get_multiple(0, SWAP_CLUSTER_SLOTS);
+    if (buf == NULL) {
+        swap_read(slot, kva);
+    } else {
+        uint32_t gens[SWAP_CLUSTER_SLOTS];
+        size_t first = swap_read_cluster(slot, buf, gens);
+        memcpy(kva, buf + (slot - first) * PGSIZE, PGSIZE);
+        anon_readahead(page, first, buf, gens);
+        palloc_free_multiple(buf, SWAP_CLUSTER_SLOTS);
+    }
+    swap_free(slot);
+    anon_set_slot(page, SWAP_SLOT_NONE);
     return true;
 }
 
-/* Swap out the page by writing contents to the swap disk. */
+/* Maps the pages around PAGE that are still swapped out into the
+ * cluster starting at slot FIRST, whose contents are in BUF as of the
+ * slot generations in GENS.  A slot counts only if it holds the page
+ * at the same distance from PAGE in virtual memory, which is how
+ * swap-out lays runs of pages down, and only if it was not allocated
+ * or written since the read: pageoutd may have put a neighbour there
+ * in the meantime.  Both are checked under FRAME_LOCK, which swap-out
+ * holds, and once they hold the slot cannot change, since only its
+ * owner, the current thread, brings the page back.  Readahead is best
+ * effort; a page we fail to map just faults later. */
+static void anon_readahead(struct page *page, size_t first, const uint8_t *buf,
+                           const uint32_t *gens) {
+    struct supplemental_page_table *spt = &page->owner->spt;
+    size_t slot = page->anon.swap_slot;
+
+    for (size_t i = first; i < first + SWAP_CLUSTER_SLOTS; i++) {
+        uint8_t *va = (uint8_t *)page->va + ((ptrdiff_t)i - (ptrdiff_t)slot) * PGSIZE;
+        if (i == slot || va == NULL || !is_user_vaddr(va))
+            continue;
+
+        struct page *p = spt_find_page(spt, va);
+        bool current;
+
+        if (p == NULL || p->operations != &anon_ops)
+            continue;
+        lock_acquire(&frame_lock);
+        current = p->anon.swap_slot == i && p->frame == NULL && swap_gen(i) == gens[i - first];
+        lock_release(&frame_lock);
+        if (!current || !vm_claim_page_from(p, buf + (i - first) * PGSIZE))
+            continue;
+
+        /* Once claimed the page may be evicted again, into another
+         * slot, before we get here. */
+        lock_acquire(&frame_lock);
+        if (p->anon.swap_slot == i)
+            anon_set_slot(p, SWAP_SLOT_NONE);
+        lock_release(&frame_lock);
+        swap_free(i);
+    }
+}
+
+/* Swap out the page by writing contents to the swap disk.
+ * If the page right before or after this one in memory was the last
+ * one swapped out of this process, the slot next to its slot is tried
+ * first, so that runs of pages end up in runs of slots.
+ * The frame is written once even if other pages share it: they all
+ * get the slot, which counts each of them as a user.
+ * Called by vm_write_out() without FRAME_LOCK, on a busy frame whose
+ * pages are unmapped; the lock is taken only around the bookkeeping. */
 static bool anon_swap_out(struct page *page) {
     struct anon_page *anon_page = &page->anon;
+    struct supplemental_page_table *spt = &page->owner->spt;
+    struct frame *frame = page->frame;
+    size_t hint = SWAP_SLOT_NONE;
+
+    lock_acquire(&frame_lock);
+    if (spt->swap_hint_slot != SWAP_SLOT_NONE) {
+        if (page->va == spt->swap_hint_va + PGSIZE)
+            hint = spt->swap_hint_slot + 1;
+        else if (page->va == spt->swap_hint_va - PGSIZE)
+            hint = spt->swap_hint_slot - 1;
+    }
+    lock_release(&frame_lock);
+
+    size_t slot = swap_alloc(hint);
+    if (slot == SWAP_SLOT_NONE)
+        return false;
+    swap_write(slot, frame->kva);
+
+    lock_acquire(&frame_lock);
+    for (struct list_elem *e = list_begin(&frame->rmap); e != list_end(&frame->rmap);
+         e = list_next(e)) {
+        struct page *p = list_entry(e, struct page, rmap_elem);
+        ASSERT(p->operations == &anon_ops);
+        if (p != page)
+            swap_dup(slot);
+        anon_set_slot(p, slot);
+    }
+    ASSERT(anon_page->swap_slot == slot);
+    spt->swap_hint_va = page->va;
+    spt->swap_hint_slot = slot;
+    lock_release(&frame_lock);
+    return true;
+}
+
+/* Makes PAGE, a new anonymous page, hold the same swapped out
+ * contents as SRC, which has no frame, by taking another reference to
+ * its swap slot.  Used by fork, which thus copies a page in swap
+ * without reading it in.  FRAME_LOCK must be held, which keeps
+ * pageoutd from changing the slot under us; SRC's owner, the only one
+ * that swaps SRC in, is waiting for the fork. */
+void anon_share_slot(struct page *page, struct page *src) {
+    ASSERT(lock_held_by_current_thread(&frame_lock));
+    ASSERT(src->operations == &anon_ops && src->frame == NULL);
+
+    if (src->anon.swap_slot != SWAP_SLOT_NONE)
+        swap_dup(src->anon.swap_slot);
+    anon_set_slot(page, src->anon.swap_slot);
+}
+
+/* Sets the swap slot of PAGE to SLOT, counting the page in or out of
+ * its owner's swapped pages. */
+static void anon_set_slot(struct page *page, size_t slot) {
+    struct anon_page *anon_page = &page->anon;
+
+    if (anon_page->swap_slot == SWAP_SLOT_NONE && slot != SWAP_SLOT_NONE)
+        spt_account(&page->owner->spt, 0, 1);
+    else if (anon_page->swap_slot != SWAP_SLOT_NONE && slot == SWAP_SLOT_NONE)
+        spt_account(&page->owner->spt, 0, -1);
+    anon_page->swap_slot = slot;
 }
 
 /* Destroy the anonymous page. PAGE will be freed by the caller. */
 static void anon_destroy(struct page *page) {
     struct anon_page *anon_page = &page->anon;
 
-    if(page->frame != NULL)
-        free(page->frame);
-    free(page);
+    swap_free(anon_page->swap_slot);
+    anon_set_slot(page, SWAP_SLOT_NONE);
+    vm_free_frame(page);
 }
@@ -2,9 +2,22 @@
 
 #include "vm/vm.h"
 
+#include "threads/mmu.h"
+#include "threads/vaddr.h"
+
 static bool file_backed_swap_in(struct page *page, void *kva);
 static bool file_backed_swap_out(struct page *page);
 static void file_backed_destroy(struct page *page);
+static bool lazy_load_mapping(struct page *page, void *aux);
+static void mapping_locate(struct page *page, struct vma *vma);
+static bool mapping_readahead(struct page *page, struct vma *vma);
+static bool mapping_fill(struct page *page, void *aux);
+
+/* A page read ahead in a mapping, for mapping_fill(). */
+struct mapping_page {
+    struct vma *vma;      /* Region of the page. */
+    const void *contents; /* Its contents, already read. */
+};
 
 /* DO NOT MODIFY this struct */
 static const struct page_operations file_ops = {
@@ -16,39 +29,213 @@ static const struct page_operations file_ops = {
 
 /* The initializer of file vm */
 void vm_file_init(void) {
-    
-
 }
 
 /* Initialize the file backed page */
-bool file_backed_initializer(struct page *page, enum vm_type type, void *kva) {
+bool file_backed_initializer(struct page *page, enum vm_type type UNUSED, void *kva UNUSED) {
     /* Set up the handler */
     page->operations = &file_ops;
 
     struct file_page *file_page = &page->file;
+    file_page->file = NULL;
+    file_page->ofs = 0;
+    file_page->read_bytes = 0;
+    return true;
+}
+
+/* Fills PAGE on its first fault from the mapping region AUX, and
+ * records where in the file the page lives for later swap-ins and
+ * writebacks.  In a region advised MADV_SEQUENTIAL the pages after it
+ * are read in the same go. */
+static bool lazy_load_mapping(struct page *page, void *aux) {
+    struct vma *vma = aux;
+
+    mapping_locate(page, vma);
+    if (vma->advice == MADV_SEQUENTIAL && mapping_readahead(page, vma))
+        return true;
+    return file_backed_swap_in(page, page->frame->kva);
+}
+
+/* Records in PAGE where in the file of region VMA it lives. */
+static void mapping_locate(struct page *page, struct vma *vma) {
+    struct file_page *file_page = &page->file;
+    size_t page_ofs = page->va - vma->start;
+
+    file_page->file = vma->file;
+    file_page->ofs = vma->ofs + page_ofs;
+    file_page->read_bytes = 0;
+    if (page_ofs < vma->read_bytes)
+        file_page->read_bytes =
+            vma->read_bytes - page_ofs < PGSIZE ? vma->read_bytes - page_ofs : PGSIZE;
+}
+
+/* Fills PAGE, and maps the untouched pages of the readahead window
+ * that starts at PAGE, with a single file_read_at().  The window is
+ * clipped to the file bytes of VMA.  Returns false, with nothing done,
+ * if there is nothing to read ahead or no buffer to read into. */
+static bool mapping_readahead(struct page *page, struct vma *vma) {
+    uint8_t *lo = page->va;
+    uint8_t *file_end = pg_round_up(vma->start + vma->read_bytes);
+    uint8_t *hi = lo + vm_readahead_pages(vma) * PGSIZE;
+    size_t bytes, size;
+    uint8_t *buf;
+
+    if (hi > file_end)
+        hi = file_end;
+    if (hi <= lo + PGSIZE)
+        return false;
+    size = hi - lo;
+    buf = palloc_get_multiple(0, size / PGSIZE);
+    if (buf == NULL)
+        return false;
+
+    bytes = vma->read_bytes - (lo - (uint8_t *)vma->start);
+    if (bytes > size)
+        bytes = size;
+    if (file_read_at(vma->file, buf, bytes, page->file.ofs) != (off_t)bytes) {
+        palloc_free_multiple(buf, size / PGSIZE);
+        return false;
+    }
+    memset(buf + bytes, 0, size - bytes);
+
+    memcpy(page->frame->kva, buf, PGSIZE);
+    for (uint8_t *upage = lo + PGSIZE; upage < hi; upage += PGSIZE) {
+        struct mapping_page ahead = {vma, buf + (upage - lo)};
+        vm_claim_page_init(upage, mapping_fill, &ahead);
+    }
+    palloc_free_multiple(buf, size / PGSIZE);
+    return true;
+}
+
+/* Initializer for a page read ahead in a mapping: AUX is a struct
+ * mapping_page. */
+static bool mapping_fill(struct page *page, void *aux) {
+    struct mapping_page *ahead = aux;
+
+    mapping_locate(page, ahead->vma);
+    memcpy(page->frame->kva, ahead->contents, PGSIZE);
+    return true;
 }
 
 /* Swap in the page by read contents from the file. */
 static bool file_backed_swap_in(struct page *page, void *kva) {
-    struct file_page *file_page UNUSED = &page->file;
+    struct file_page *file_page = &page->file;
+
+    if (file_page->read_bytes > 0 &&
+        file_read_at(file_page->file, kva, file_page->read_bytes, file_page->ofs) !=
+            (off_t)file_page->read_bytes)
+        return false;
+    memset(kva + file_page->read_bytes, 0, PGSIZE - file_page->read_bytes);
+    return true;
+}
+
+/* Writes PAGE back to its file if it was modified through any mapping
+ * of its frame since it was read or last written back; clean pages cost nothing.  Only the part
+ * of the page that the file backs is written, so the file never grows.
+ * FRAME_LOCK must be held, which keeps the frame from being evicted
+ * under us; if the frame is being written out already, we wait for
+ * that instead. */
+void file_backed_writeback(struct page *page) {
+    struct file_page *file_page = &page->file;
+
+    ASSERT(lock_held_by_current_thread(&frame_lock));
+
+    vm_wait_frame(page);
+
+    /* Clear the bits first, so a write racing with ours marks them
+     * again. */
+    if (page->frame == NULL || !vm_frame_test_and_clear_dirty(page->frame))
+        return;
+    if (file_page->read_bytes > 0)
+        file_write_at(file_page->file, page->frame->kva, file_page->read_bytes, file_page->ofs);
 }
 
-/* Swap out the page by writeback contents to the file. */
+/* Swap out the page by writeback contents to the file.
+ * Called by vm_write_out() without FRAME_LOCK, on a busy frame whose
+ * pages are unmapped, so nothing can dirty it after the check. */
 static bool file_backed_swap_out(struct page *page) {
-    struct file_page *file_page UNUSED = &page->file;
+    struct file_page *file_page = &page->file;
+    bool dirty;
+
+    lock_acquire(&frame_lock);
+    dirty = vm_frame_test_and_clear_dirty(page->frame);
+    lock_release(&frame_lock);
+    if (dirty && file_page->read_bytes > 0)
+        file_write_at(file_page->file, page->frame->kva, file_page->read_bytes, file_page->ofs);
+    return true;
 }
 
 /* Destory the file backed page. PAGE will be freed by the caller. */
 static void file_backed_destroy(struct page *page) {
-    struct file_page *file_page UNUSED = &page->file;
+    file_backed_writeback(page);
+    vm_free_frame(page);
 }
 
-/* Do the mmap */
+/* Do the mmap.
+ * Maps LENGTH bytes of FILE starting at OFFSET to ADDR as one region.
+ * Nothing is read until the pages are touched, and the part of the
+ * last page past the end of the file reads as zeros.  Returns ADDR, or
+ * NULL if the arguments are bad or the range is already in use. */
 void *do_mmap(void *addr, size_t length, int writable, struct file *file, off_t offset) {
+    struct supplemental_page_table *spt = &thread_current()->spt;
+    void *end = pg_round_up(addr + length);
+    size_t read_bytes = 0;
+    off_t file_len;
 
+    if (addr == NULL || pg_ofs(addr) != 0 || offset < 0 || pg_ofs(offset) != 0 || length == 0 ||
+        end <= addr || !is_user_vaddr(addr) || !is_user_vaddr(end - 1))
+        return NULL;
+
+    /* The mapping keeps its own handle, so it outlives close(). */
+    file = file_reopen(file);
+    if (file == NULL)
+        return NULL;
+
+    file_len = file_length(file);
+    if (offset < file_len)
+        read_bytes = (size_t)(file_len - offset) < length ? (size_t)(file_len - offset) : length;
+
+    if (vma_create(spt, addr, end, VM_FILE, writable, file, offset, read_bytes,
+                   lazy_load_mapping) == NULL)
+        return NULL;
+    return addr;
 }
 
-/* Do the munmap */
+/* Do the munmap.
+ * Removes the mapping that starts at ADDR, writing back the pages that
+ * were modified. */
 void do_munmap(void *addr) {
+    struct supplemental_page_table *spt = &thread_current()->spt;
+    struct vma *vma = vma_find(spt, addr);
+
+    if (vma == NULL || vma->start != addr || VM_TYPE(vma->type) != VM_FILE)
+        return;
+
+    spt_remove_range(spt, vma->start, vma->end);
+    vma_destroy(spt, vma);
+}
+
+/* Writes back the modified pages of file mappings in
+ * [ADDR, ADDR + LENGTH) without unmapping them.  Returns 0 on success,
+ * or -1 if part of the range is not file mapped. */
+int do_msync(void *addr, size_t length) {
+    struct supplemental_page_table *spt = &thread_current()->spt;
+    void *end = addr + length;
+
+    if (pg_ofs(addr) != 0 || end < addr)
+        return -1;
+
+    for (void *va = addr; va < end; va += PGSIZE) {
+        struct vma *vma = vma_find(spt, va);
+        if (vma == NULL || VM_TYPE(vma->type) != VM_FILE)
+            return -1;
 
+        struct page *page = spt_find_page(spt, va);
+        if (page != NULL && page->operations->type == VM_FILE) {
+            lock_acquire(&frame_lock);
+            file_backed_writeback(page);
+            lock_release(&frame_lock);
+        }
+    }
+    return 0;
 }
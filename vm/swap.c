@@ -0,0 +1,200 @@
+/* swap.c: Swap slot manager for the swap disk (hd1:1).
+ *
+ * The swap disk is carved into page-sized slots of SECTORS_PER_PAGE
+ * consecutive sectors.  A bitmap records which slots are in use; a page
+ * is always moved as a whole slot with one multi-sector transfer.
+ *
+ * A slot may hold the contents of several pages at once, when a frame
+ * they shared copy-on-write was swapped out; each slot has a count of
+ * its users, and is freed when the last one lets go.
+ *
+ * Slots are grouped into aligned clusters of SWAP_CLUSTER_SLOTS.  The
+ * allocator lets callers keep virtually adjacent pages in adjacent
+ * slots, so that a whole cluster can be read back in one transfer.
+ * Each slot has a generation, bumped whenever it is allocated or
+ * written, by which a reader of a cluster can tell which of the slots
+ * it read were rewritten since.
+ *
+ * Reads and writes go through the compressed cache in zswap.c first;
+ * the disk only sees the pages that do not fit there. */
+
+#include "vm/swap.h"
+
+#include <bitmap.h>
+#include <debug.h>
+#include <stdint.h>
+
+#include "threads/malloc.h"
+#include "threads/synch.h"
+#include "vm/zswap.h"
+
+static struct disk *swap_disk;
+static struct bitmap *swap_slots; /* Set bit = slot in use. */
+static uint16_t *swap_refs;       /* Users of each slot in use. */
+static uint32_t *swap_gens;       /* Generation of each slot. */
+static struct lock swap_lock;     /* Guards SWAP_SLOTS, SWAP_REFS and SWAP_GENS. */
+
+static bool swap_in_use(size_t slot);
+
+/* Takes ownership of DISK as the swap device.  DISK may be null if no
+ * swap disk was attached, in which case every allocation fails. */
+void swap_init(struct disk *disk) {
+    lock_init(&swap_lock);
+    swap_disk = disk;
+    swap_slots = NULL;
+    if (swap_disk == NULL)
+        return;
+
+    swap_slots = bitmap_create(disk_size(swap_disk) / SECTORS_PER_PAGE);
+    if (swap_slots == NULL)
+        PANIC("swap: cannot allocate slot bitmap");
+    swap_refs = calloc(bitmap_size(swap_slots), sizeof *swap_refs);
+    swap_gens = calloc(bitmap_size(swap_slots), sizeof *swap_gens);
+    if (swap_refs == NULL || swap_gens == NULL)
+        PANIC("swap: cannot allocate slot counts");
+    zswap_init();
+}
+
+/* Reserves a free swap slot and returns its number, or SWAP_SLOT_NONE if
+ * the swap disk is full or absent.  HINT, unless SWAP_SLOT_NONE, is the
+ * slot the caller would like, typically next to a virtual neighbour's;
+ * failing that, a run is started at the head of an empty cluster, and
+ * failing that any free slot is taken. */
+size_t swap_alloc(size_t hint) {
+    size_t slot_cnt, slot = BITMAP_ERROR;
+
+    if (swap_slots == NULL)
+        return SWAP_SLOT_NONE;
+
+    slot_cnt = bitmap_size(swap_slots);
+    lock_acquire(&swap_lock);
+    if (hint < slot_cnt && !bitmap_test(swap_slots, hint)) {
+        bitmap_mark(swap_slots, hint);
+        slot = hint;
+    }
+    for (size_t i = 0; slot == BITMAP_ERROR && i + SWAP_CLUSTER_SLOTS <= slot_cnt;
+         i += SWAP_CLUSTER_SLOTS) {
+        if (bitmap_none(swap_slots, i, SWAP_CLUSTER_SLOTS)) {
+            bitmap_mark(swap_slots, i);
+            slot = i;
+        }
+    }
+    if (slot == BITMAP_ERROR)
+        slot = bitmap_scan_and_flip(swap_slots, 0, 1, false);
+    if (slot != BITMAP_ERROR) {
+        swap_refs[slot] = 1;
+        swap_gens[slot]++;
+    }
+    lock_release(&swap_lock);
+    return slot == BITMAP_ERROR ? SWAP_SLOT_NONE : slot;
+}
+
+/* Adds a user to SLOT, which must be in use. */
+void swap_dup(size_t slot) {
+    ASSERT(slot != SWAP_SLOT_NONE);
+
+    lock_acquire(&swap_lock);
+    ASSERT(bitmap_test(swap_slots, slot));
+    ASSERT(swap_refs[slot] < UINT16_MAX);
+    swap_refs[slot]++;
+    lock_release(&swap_lock);
+}
+
+/* Drops a user of SLOT, and returns it to the free pool if that was
+ * the last one.  SWAP_SLOT_NONE is ignored.  The slot's compressed
+ * copy is dropped before the slot is, so that it cannot take out the
+ * copy of whoever gets the slot next. */
+void swap_free(size_t slot) {
+    if (slot == SWAP_SLOT_NONE)
+        return;
+
+    lock_acquire(&swap_lock);
+    ASSERT(bitmap_test(swap_slots, slot));
+    if (--swap_refs[slot] == 0) {
+        zswap_invalidate(slot);
+        bitmap_reset(swap_slots, slot);
+    }
+    lock_release(&swap_lock);
+}
+
+/* Reads the page stored in SLOT into KVA. */
+void swap_read(size_t slot, void *kva) {
+    ASSERT(slot != SWAP_SLOT_NONE);
+    if (!zswap_load(slot, kva))
+        disk_read_multiple(swap_disk, slot * SECTORS_PER_PAGE, kva, SECTORS_PER_PAGE);
+}
+
+/* Returns the generation of SLOT.  If it is the same after the slot is
+ * read as before, the slot was neither reallocated nor written in
+ * between. */
+uint32_t swap_gen(size_t slot) {
+    ASSERT(slot != SWAP_SLOT_NONE);
+
+    lock_acquire(&swap_lock);
+    uint32_t gen = swap_gens[slot];
+    lock_release(&swap_lock);
+    return gen;
+}
+
+/* Reads the whole cluster that holds SLOT into BUF, which must have
+ * room for SWAP_CLUSTER_SLOTS pages, and the generation of each of its
+ * slots, as of before the read, into GENS.  Returns the first slot of
+ * the cluster; slot N of it lands at page N - (returned slot) of BUF
+ * and element N - (returned slot) of GENS.  Slots not in use read as
+ * garbage.  The disk is read with a single transfer, and only if some
+ * slot in use is not in the compressed cache. */
+size_t swap_read_cluster(size_t slot, void *buf, uint32_t *gens) {
+    size_t first = slot / SWAP_CLUSTER_SLOTS * SWAP_CLUSTER_SLOTS;
+    size_t cnt = bitmap_size(swap_slots) - first;
+    bool disk_read = false;
+
+    ASSERT(slot != SWAP_SLOT_NONE);
+    if (cnt > SWAP_CLUSTER_SLOTS)
+        cnt = SWAP_CLUSTER_SLOTS;
+    lock_acquire(&swap_lock);
+    for (size_t i = 0; i < SWAP_CLUSTER_SLOTS; i++)
+        gens[i] = i < cnt ? swap_gens[first + i] : 0;
+    lock_release(&swap_lock);
+    for (size_t i = 0; i < cnt && !disk_read; i++) {
+        if (swap_in_use(first + i) && !zswap_contains(first + i)) {
+            disk_read_multiple(swap_disk, first * SECTORS_PER_PAGE, buf,
+                               cnt * SECTORS_PER_PAGE);
+            disk_read = true;
+        }
+    }
+
+    /* A cached page may be written back and dropped between the checks
+     * above and its load; it is on disk by then. */
+    for (size_t i = 0; i < cnt; i++) {
+        void *kva = buf + i * PGSIZE;
+        if (!zswap_load(first + i, kva) && !disk_read && swap_in_use(first + i))
+            disk_read_multiple(swap_disk, (first + i) * SECTORS_PER_PAGE, kva,
+                               SECTORS_PER_PAGE);
+    }
+    return first;
+}
+
+/* Writes the page at KVA into SLOT. */
+void swap_write(size_t slot, const void *kva) {
+    ASSERT(slot != SWAP_SLOT_NONE);
+    if (!zswap_store(slot, kva))
+        swap_write_disk(slot, kva);
+
+    lock_acquire(&swap_lock);
+    swap_gens[slot]++;
+    lock_release(&swap_lock);
+}
+
+/* Writes the page at KVA into SLOT on disk, bypassing the cache. */
+void swap_write_disk(size_t slot, const void *kva) {
+    ASSERT(slot != SWAP_SLOT_NONE);
+    disk_write_multiple(swap_disk, slot * SECTORS_PER_PAGE, kva, SECTORS_PER_PAGE);
+}
+
+/* Returns true if SLOT is allocated. */
+static bool swap_in_use(size_t slot) {
+    lock_acquire(&swap_lock);
+    bool in_use = bitmap_test(swap_slots, slot);
+    lock_release(&swap_lock);
+    return in_use;
+}
@@ -57,9 +57,8 @@ static bool uninit_initialize(struct page *page, void *kva) {
  PAGE will be freed by the caller. */
 static void uninit_destroy(struct page *page) {
     struct uninit_page *uninit UNUSED = &page->uninit;
-    
-    /* TODO: Fill this function.
-    * TODO: If you don't have anything to do, just return. */
-    free(page);
+
+    /* AUX is the page's region, which owns everything the initializer
+     * needs and outlives the page; nothing to release here. */
 }
 
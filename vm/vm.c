@@ -2,9 +2,113 @@
 
 #include "vm/vm.h"
 
+#include <round.h>
+#include <stdio.h>
+
+#include "devices/timer.h"
+#include "filesys/file.h"
+#include "filesys/inode.h"
 #include "threads/malloc.h"
 #include "threads/mmu.h"
 #include "vm/inspect.h"
+#include "vm/swap.h"
+
+/* Global frame table.  Holds every user frame that currently backs a
+ * page, in the order the clock hand sweeps them.  FRAME_LOCK guards the
+ * table, the hand, and the page <-> frame links of every page. */
+static struct list frame_table;
+struct lock frame_lock;
+static struct list_elem *clock_hand;
+static size_t frame_cnt;
+
+/* Frames being written out are out of the frame table and marked
+ * busy, and FRAME_LOCK is dropped for the disk I/O.  Whoever needs one
+ * of them back waits on FRAME_IDLE, which is broadcast whenever a
+ * batch of write-outs finishes.  BUSY_CNT counts the busy frames. */
+static struct condition frame_idle;
+static size_t busy_cnt;
+static void vm_wait_range(struct supplemental_page_table *spt, void *start, void *end);
+
+/* Frame descriptors, one per page of the user pool, indexed by page
+ * number from the start of the pool.  Allocating a frame is then just
+ * allocating its page. */
+static struct frame *frame_array;
+static void *frame_array_base;
+static size_t frame_array_cnt;
+static void frame_array_init(void);
+
+/* Read-only frame of zeros mapped for read faults on untouched
+ * anonymous pages.  It is not in the frame table, and its reference
+ * count includes one for itself so that it is never freed. */
+static struct frame *zero_frame;
+
+/* Page-out daemon.  It sleeps on PAGEOUT_SEMA until the number of free
+ * user frames drops below PAGEOUT_LOW, then evicts until PAGEOUT_HIGH
+ * frames are free, so that faults rarely have to evict for themselves.
+ * PAGEOUT_WOKEN keeps allocations from piling up wakeups. */
+static struct semaphore pageout_sema;
+static bool pageout_woken;
+static size_t pageout_low, pageout_high;
+static void vm_pageoutd(void *aux);
+
+/* Frames the page-out daemon evicts at a time.  Their pages are all
+ * unmapped before any is written out, so their TLB entries go stale
+ * together and are invalidated together. */
+#define PAGEOUT_BATCH 16
+
+/* Teardown of a range of one address space in progress.  While it is
+ * set, vm_free_frame() leaves the page table of PML4 alone and queues
+ * the frames that lose their last page on FRAMES; vm_unmap_end() then
+ * clears the range and invalidates the TLB in one pass, and only then
+ * frees the frames.  Set only with FRAME_LOCK held, which is held for
+ * the whole teardown. */
+struct unmap_batch {
+    uint64_t *pml4;    /* Address space being torn down. */
+    struct list frames; /* Frames to free once the TLB is clean. */
+};
+static struct unmap_batch *unmap_batch;
+
+/* Same-page merging daemon.  Every KSM_SLEEP_TICKS it checksums the
+ * next KSM_SCAN_BATCH frames of the frame table, and folds a private
+ * anonymous frame whose contents equal those of a frame already seen
+ * into that frame, shared copy-on-write.  KSM_TABLE holds the frames
+ * seen in the current sweep of the table, keyed by checksum;
+ * KSM_CURSOR is the next frame to scan, or NULL at the end of a sweep.
+ * KSM_MERGED counts the frames freed this way. */
+#define KSM_SLEEP_TICKS (TIMER_FREQ / 10)
+#define KSM_SCAN_BATCH 64
+static struct hash ksm_table;
+static struct list_elem *ksm_cursor;
+static size_t ksm_merged;
+static void vm_ksmd(void *aux UNUSED);
+static void ksm_forget(struct frame *frame);
+static uint64_t ksm_hash(const struct hash_elem *e, void *aux UNUSED);
+static bool ksm_less(const struct hash_elem *a, const struct hash_elem *b, void *aux UNUSED);
+
+/* Shared text.  Frames holding a page of a read-only segment that is
+ * read from the executable are kept in TEXT_TABLE, keyed by the
+ * executable's inode and the page's file offset, so that processes
+ * running the same program map one frame instead of each reading its
+ * own copy.  The table holds no reference: a frame leaves it when it
+ * leaves the frame table, evicted or freed with its last page.
+ * TEXT_SHARED counts the faults it resolved. */
+static struct hash text_table;
+static size_t text_shared;
+static bool text_key(struct supplemental_page_table *spt, void *va, struct frame *key);
+static void text_publish(struct frame *frame, struct page *page);
+static void text_forget(struct frame *frame);
+static uint64_t text_hash(const struct hash_elem *e, void *aux UNUSED);
+static bool text_less(const struct hash_elem *a, const struct hash_elem *b, void *aux UNUSED);
+
+/* Window, in pages, that a fault on a file-backed region populates. */
+size_t fault_around_pages = 16;
+
+/* How many times wider the window is in a region advised
+ * MADV_SEQUENTIAL, where it also runs ahead of the fault only. */
+#define SEQUENTIAL_READAHEAD_SCALE 4
+
+/* Most the stack may grow, in bytes.  The heap stays below it. */
+#define STACK_MAX (1 << 20)
 
 /* Initializes the virtual memory subsystem by invoking each subsystem's
  * intialize codes. */
@@ -16,7 +120,79 @@ void vm_init(void) {
 #endif
     register_inspect_intr();
     /* DO NOT MODIFY UPPER LINES. */
-    /* TODO: Your code goes here. */
+    vmstat_init();
+    list_init(&frame_table);
+    lock_init(&frame_lock);
+    cond_init(&frame_idle);
+    busy_cnt = 0;
+    clock_hand = NULL;
+    frame_cnt = 0;
+    frame_array_init();
+
+    zero_frame = malloc(sizeof *zero_frame);
+    if (zero_frame == NULL)
+        PANIC("vm: cannot allocate the zero frame");
+    zero_frame->kva = palloc_get_page(PAL_ASSERT | PAL_ZERO);
+    list_init(&zero_frame->rmap);
+    zero_frame->ref_cnt = 1;
+    zero_frame->pin_cnt = 0;
+    zero_frame->huge_accessed = false;
+    zero_frame->busy = false;
+
+    /* Aim for about 1.5% to 3% of the user pool free. */
+    pageout_low = palloc_free_cnt(PAL_USER) / 64;
+    if (pageout_low < 4)
+        pageout_low = 4;
+    pageout_high = 2 * pageout_low;
+    sema_init(&pageout_sema, 0);
+    pageout_woken = false;
+    thread_create("pageoutd", PRI_DEFAULT, vm_pageoutd, NULL);
+
+    hash_init(&ksm_table, ksm_hash, ksm_less, NULL);
+    ksm_cursor = NULL;
+    ksm_merged = 0;
+    thread_create("ksmd", PRI_MIN, vm_ksmd, NULL);
+
+    hash_init(&text_table, text_hash, text_less, NULL);
+    text_shared = 0;
+}
+
+/* Sets up the frame descriptors of the user pool.  They take
+ * sizeof (struct frame) bytes per page of it, about 3%, from the
+ * kernel pool.  This runs in vm_init() rather than in palloc_init(),
+ * since palloc is built without VM too, and no user page has been
+ * handed out yet by then. */
+static void frame_array_init(void) {
+    size_t pages;
+
+    palloc_user_range(&frame_array_base, &frame_array_cnt);
+    pages = DIV_ROUND_UP(frame_array_cnt * sizeof *frame_array, PGSIZE);
+    frame_array = palloc_get_multiple(PAL_ASSERT, pages);
+    for (size_t i = 0; i < frame_array_cnt; i++) {
+        struct frame *frame = &frame_array[i];
+        frame->kva = frame_array_base + i * PGSIZE;
+        list_init(&frame->rmap);
+        frame->ref_cnt = 0;
+        frame->pin_cnt = 0;
+        frame->huge_accessed = false;
+        frame->busy = false;
+    }
+}
+
+/* Returns the descriptor of the frame at KVA, which must be a page of
+ * the user pool. */
+struct frame *vm_frame_lookup(void *kva) {
+    size_t idx = pg_no(kva) - pg_no(frame_array_base);
+
+    ASSERT(pg_ofs(kva) == 0);
+    ASSERT(idx < frame_array_cnt);
+    return &frame_array[idx];
+}
+
+/* Prints virtual memory statistics. */
+void vm_print_stats(void) {
+    printf("VM: %zu frames saved by same-page merging\n", ksm_merged);
+    printf("VM: %zu text pages mapped from other processes\n", text_shared);
 }
 static unsigned page_hash(const struct hash_elem *p_, void *aux UNUSED);
 static bool page_less(const struct hash_elem *a_, const struct hash_elem *b_, void *aux UNUSED);
@@ -39,6 +215,28 @@ enum vm_type page_get_type(struct page *page) {
 static struct frame *vm_get_victim(void);
 static bool vm_do_claim_page(struct page *page);
 static struct frame *vm_evict_frame(void);
+static size_t vm_evict_frames(struct frame **frames, size_t cnt);
+static size_t vm_write_out(struct frame **frames, size_t cnt);
+static struct frame *vm_get_local_victim(struct supplemental_page_table *spt);
+static struct frame *vm_evict_local(struct supplemental_page_table *spt);
+static void vm_unmap_begin(struct unmap_batch *batch, uint64_t *pml4);
+static void vm_unmap_end(struct unmap_batch *batch, void *start, void *end);
+static struct page *vm_instantiate_page(struct supplemental_page_table *spt, void *va);
+static bool vm_map_huge_page(struct supplemental_page_table *spt, void *va);
+static bool vm_map_text_page(struct supplemental_page_table *spt, void *va);
+static void vm_discard_frame(struct frame *frame);
+static void frame_table_insert(struct frame *frame);
+static void frame_table_remove(struct frame *frame);
+static void frame_link(struct frame *frame, struct page *page);
+static void frame_unlink(struct frame *frame, struct page *page);
+static struct page *frame_any_page(struct frame *frame);
+static bool frame_test_and_clear_accessed(struct frame *frame);
+static bool vm_pin_page(void *va, bool write);
+static void vm_unpin_page(void *va);
+static bool vm_oom_kill(void);
+static void vm_oom_reclaim(struct thread *victim);
+static void vm_drop_behind(struct supplemental_page_table *spt, void *va);
+static void frame_table_deactivate(struct frame *frame);
 
 /* Create the pending page object with initializer. If you want to create a
   page, do not create it directly and make it through this function or
@@ -61,12 +259,14 @@ bool vm_alloc_page_with_initializer(enum vm_type type, void *upage, bool writabl
                 uninit_new(page, upage, init, type, aux, anon_initializer);
                 break;
             case VM_FILE:
+                uninit_new(page, upage, init, type, aux, file_backed_initializer);
                 break;
             default:
                 break;
         }
 
         page->writable = writable;
+        page->owner = thread_current();
 
         if (!spt_insert_page(spt, page)) {
             return false;
@@ -105,74 +305,1287 @@ bool spt_insert_page(struct supplemental_page_table *spt, struct page *page) {
 }
 
 void spt_remove_page(struct supplemental_page_table *spt, struct page *page) {
-    vm_dealloc_page(page);
-    return true;
+    hash_delete(&spt->spt_hash_table, &page->hash_elem);
+    lock_acquire(&frame_lock);
+    vm_wait_frame(page);
+    destroy(page);
+    lock_release(&frame_lock);
+    free(page);
+}
+
+/* Removes the pages of SPT, the current thread's table, in
+ * [START, END), unmapping them all with a single pass over the page
+ * table and one round of TLB invalidation. */
+void spt_remove_range(struct supplemental_page_table *spt, void *start, void *end) {
+    struct unmap_batch batch;
+
+    lock_acquire(&frame_lock);
+    vm_wait_range(spt, start, end);
+    vm_unmap_begin(&batch, thread_current()->pml4);
+    for (void *va = start; va < end; va += PGSIZE) {
+        struct page *page = spt_find_page(spt, va);
+        if (page != NULL) {
+            hash_delete(&spt->spt_hash_table, &page->hash_elem);
+            destroy(page);
+            free(page);
+        }
+    }
+    vm_unmap_end(&batch, start, end);
+    lock_release(&frame_lock);
+}
+
+/* Starts tearing down mappings of PML4 as BATCH.  FRAME_LOCK must be
+ * held until the matching vm_unmap_end(). */
+static void vm_unmap_begin(struct unmap_batch *batch, uint64_t *pml4) {
+    ASSERT(lock_held_by_current_thread(&frame_lock));
+    ASSERT(unmap_batch == NULL);
+
+    batch->pml4 = pml4;
+    list_init(&batch->frames);
+    unmap_batch = batch;
+}
+
+/* Finishes BATCH: unmaps [START, END) of its address space, which
+ * must cover every page destroyed since vm_unmap_begin(), invalidates
+ * the TLB, and frees the frames left unused. */
+static void vm_unmap_end(struct unmap_batch *batch, void *start, void *end) {
+    struct tlb_batch tlb;
+
+    ASSERT(unmap_batch == batch);
+    tlb_batch_init(&tlb);
+    if (batch->pml4 != NULL)
+        pml4_unmap_range(batch->pml4, start, end, &tlb);
+    tlb_batch_flush(&tlb);
+    unmap_batch = NULL;
+
+    while (!list_empty(&batch->frames))
+        vm_discard_frame(list_entry(list_pop_front(&batch->frames), struct frame, frame_elem));
+}
+
+/* Adds FRAME to the frame table, just behind the clock hand so that it
+ * is the last one the hand reaches. */
+static void frame_table_insert(struct frame *frame) {
+    ASSERT(lock_held_by_current_thread(&frame_lock));
+
+    if (clock_hand == NULL)
+        list_push_back(&frame_table, &frame->frame_elem);
+    else
+        list_insert(clock_hand, &frame->frame_elem);
+    frame_cnt++;
+}
+
+/* Removes FRAME from the frame table, moving the clock hand and the
+ * merging daemon's cursor past it. */
+static void frame_table_remove(struct frame *frame) {
+    ASSERT(lock_held_by_current_thread(&frame_lock));
+
+    if (clock_hand == &frame->frame_elem)
+        clock_hand = list_next(clock_hand);
+    if (clock_hand == list_end(&frame_table))
+        clock_hand = NULL;
+    if (ksm_cursor == &frame->frame_elem)
+        ksm_cursor = list_next(ksm_cursor);
+    if (ksm_cursor == list_end(&frame_table))
+        ksm_cursor = NULL;
+    ksm_forget(frame);
+    text_forget(frame);
+    list_remove(&frame->frame_elem);
+    frame_cnt--;
+}
+
+/* Moves FRAME, its accessed bits cleared, right under the clock hand,
+ * so that it is the next frame the hand picks. */
+static void frame_table_deactivate(struct frame *frame) {
+    ASSERT(lock_held_by_current_thread(&frame_lock));
+
+    frame_test_and_clear_accessed(frame);
+    frame_table_remove(frame);
+    frame_table_insert(frame);
+    clock_hand = &frame->frame_elem;
 }
 
-/* Get the struct frame, that will be evicted. */
+/* Records that PAGE maps FRAME. */
+static void frame_link(struct frame *frame, struct page *page) {
+    page->frame = frame;
+    list_push_back(&frame->rmap, &page->rmap_elem);
+    frame->ref_cnt++;
+    if (frame != zero_frame) {
+        enum intr_level old_level = intr_disable();
+        list_push_back(&page->owner->spt.resident_list, &page->resident_elem);
+        intr_set_level(old_level);
+        spt_account(&page->owner->spt, 1, 0);
+    }
+}
+
+/* Records that PAGE no longer maps FRAME.  The page table is left to
+ * the caller. */
+static void frame_unlink(struct frame *frame, struct page *page) {
+    ASSERT(page->frame == frame);
+    page->frame = NULL;
+    list_remove(&page->rmap_elem);
+    frame->ref_cnt--;
+    if (frame != zero_frame) {
+        enum intr_level old_level = intr_disable();
+        list_remove(&page->resident_elem);
+        intr_set_level(old_level);
+        spt_account(&page->owner->spt, -1, 0);
+    }
+}
+
+/* Returns one of the pages that map FRAME, or NULL if none does. */
+static struct page *frame_any_page(struct frame *frame) {
+    if (list_empty(&frame->rmap))
+        return NULL;
+    return list_entry(list_front(&frame->rmap), struct page, rmap_elem);
+}
+
+/* Returns true if any page that maps FRAME has been accessed since the
+ * last call, and clears the accessed bits of all of them.
+ * The pages of a huge page share one accessed bit.  Whoever finds it
+ * set hands it on to every frame of the huge page before clearing it,
+ * so the frames the hand reaches later get their second chance too,
+ * instead of all looking cold after the first. */
+static bool frame_test_and_clear_accessed(struct frame *frame) {
+    bool accessed = false;
+
+    for (struct list_elem *e = list_begin(&frame->rmap); e != list_end(&frame->rmap);
+         e = list_next(e)) {
+        struct page *page = list_entry(e, struct page, rmap_elem);
+        uint64_t *pml4 = page->owner->pml4;
+        if (pml4 == NULL || !pml4_is_accessed(pml4, page->va))
+            continue;
+        if (pml4_is_huge(pml4, page->va)) {
+            uint8_t *base = (uint8_t *)((uint64_t)frame->kva & ~(HPGSIZE - 1));
+            for (size_t i = 0; i < HPGCNT; i++)
+                vm_frame_lookup(base + i * PGSIZE)->huge_accessed = true;
+        }
+        pml4_set_accessed(pml4, page->va, false);
+        accessed = true;
+    }
+    if (frame->huge_accessed) {
+        frame->huge_accessed = false;
+        accessed = true;
+    }
+    return accessed;
+}
+
+/* Returns true if any page that maps FRAME has written to it since the
+ * last call, and clears the dirty bits of all of them.  FRAME_LOCK
+ * must be held. */
+bool vm_frame_test_and_clear_dirty(struct frame *frame) {
+    bool dirty = false;
+
+    ASSERT(lock_held_by_current_thread(&frame_lock));
+    for (struct list_elem *e = list_begin(&frame->rmap); e != list_end(&frame->rmap);
+         e = list_next(e)) {
+        struct page *page = list_entry(e, struct page, rmap_elem);
+        uint64_t *pml4 = page->owner->pml4;
+        if (pml4 != NULL && pml4_is_dirty(pml4, page->va)) {
+            pml4_set_dirty(pml4, page->va, false);
+            dirty = true;
+        }
+    }
+    return dirty;
+}
+
+/* Releases the frame that backs PAGE, if any: unmaps it from the
+ * owner's page table and, once no other page shares it, drops it from
+ * the frame table and gives the memory back to the user pool.  Called
+ * from the destroy handlers with FRAME_LOCK held.  Within an unmap
+ * batch for the owner's address space, both the unmapping and the
+ * freeing are left to the end of the batch. */
+void vm_free_frame(struct page *page) {
+    struct frame *frame = page->frame;
+    bool deferred = unmap_batch != NULL && unmap_batch->pml4 == page->owner->pml4;
+
+    ASSERT(lock_held_by_current_thread(&frame_lock));
+    if (frame == NULL)
+        return;
+    ASSERT(!frame->busy);
+
+    if (page->owner->pml4 != NULL && !deferred)
+        pml4_clear_page(page->owner->pml4, page->va);
+    frame_unlink(frame, page);
+    if (frame->ref_cnt > 0)
+        return;
+
+    frame_table_remove(frame);
+    if (deferred)
+        list_push_back(&unmap_batch->frames, &frame->frame_elem);
+    else
+        vm_discard_frame(frame);
+}
+
+/* Waits until the frame of PAGE, if it has one, is not being written
+ * out, after which it is either gone, the page now in swap or its file,
+ * or back in place if the write failed.  FRAME_LOCK must be held; it is
+ * released while waiting. */
+void vm_wait_frame(struct page *page) {
+    ASSERT(lock_held_by_current_thread(&frame_lock));
+    while (page->frame != NULL && page->frame->busy)
+        cond_wait(&frame_idle, &frame_lock);
+}
+
+/* Waits until no page of SPT, the current thread's table, in
+ * [START, END) has its frame being written out.  FRAME_LOCK must be
+ * held, and is released while waiting; once this returns, no frame of
+ * the range becomes busy until it is released again. */
+static void vm_wait_range(struct supplemental_page_table *spt, void *start, void *end) {
+    ASSERT(lock_held_by_current_thread(&frame_lock));
+
+    for (struct list_elem *e = list_begin(&spt->resident_list); e != list_end(&spt->resident_list);) {
+        struct page *page = list_entry(e, struct page, resident_elem);
+
+        if (page->va >= start && page->va < end && page->frame->busy) {
+            /* The list may change while we wait. */
+            cond_wait(&frame_idle, &frame_lock);
+            e = list_begin(&spt->resident_list);
+        } else
+            e = list_next(e);
+    }
+}
+
+/* Get the struct frame, that will be evicted.
+ * Second-chance clock: the hand sweeps the frame table, clearing the
+ * accessed bits of every frame it passes and picking the first frame
+ * found with them all clear.  A frame counts as accessed if any of the
+ * pages on its reverse map was.  Pinned frames are passed over.  Two
+ * full turns always suffice, so the cost is bounded by the number of
+ * frames scanned. */
 static struct frame *vm_get_victim(void) {
-    struct frame *victim = NULL;
-    /* TODO: The policy for eviction is up to you. */
+    ASSERT(lock_held_by_current_thread(&frame_lock));
+
+    for (size_t i = 0; i < 2 * frame_cnt; i++) {
+        if (clock_hand == NULL)
+            clock_hand = list_begin(&frame_table);
 
-    return victim;
+        struct frame *frame = list_entry(clock_hand, struct frame, frame_elem);
+
+        clock_hand = list_next(clock_hand);
+        if (clock_hand == list_end(&frame_table))
+            clock_hand = NULL;
+
+        if (list_empty(&frame->rmap) || frame->pin_cnt > 0 ||
+            frame_test_and_clear_accessed(frame))
+            continue;
+        return frame;
+    }
+    return NULL;
 }
 
 /* Evict one page and return the corresponding frame.
  * Return NULL on error.*/
 static struct frame *vm_evict_frame(void) {
-    struct frame *victim UNUSED = vm_get_victim();
-    /* TODO: swap out the victim and return the evicted frame. */
+    struct frame *victim;
 
+    /* A victim that cannot be written out, say an anonymous page with
+     * swap full, goes back behind the hand; try the others before
+     * giving up, since clean file pages may still be dropped. */
+    for (size_t tries = frame_cnt; tries > 0; tries--)
+        if (vm_evict_frames(&victim, 1) == 1)
+            return victim;
     return NULL;
 }
 
+/* Evicts up to CNT frames, storing them, now out of the frame table,
+ * in FRAMES.  Returns the number evicted.  FRAME_LOCK must be held;
+ * it is released while the frames are written out. */
+static size_t vm_evict_frames(struct frame **frames, size_t cnt) {
+    size_t victim_cnt = 0;
+
+    ASSERT(lock_held_by_current_thread(&frame_lock));
+    while (victim_cnt < cnt) {
+        struct frame *victim = vm_get_victim();
+        if (victim == NULL)
+            break;
+
+        /* Out of the table, the hand cannot pick it twice. */
+        frame_table_remove(victim);
+        frames[victim_cnt++] = victim;
+    }
+    return vm_write_out(frames, victim_cnt);
+}
+
+/* Writes out the CNT frames in FRAMES, which are already out of the
+ * frame table, and packs the ones that no longer back any page at the
+ * front of FRAMES.  Returns their number; the others go back to the
+ * table.  Every page on a victim's reverse map is unmapped, and the
+ * TLB entries of all the victims are invalidated as one batch, before
+ * the first is written out.  A shared frame is written out once,
+ * through any of its pages; see anon_swap_out().
+ *
+ * FRAME_LOCK must be held, but it is released for the writes, so that
+ * faults elsewhere do not queue up behind the disk.  The victims are
+ * marked busy meanwhile: a thread that needs one waits in
+ * vm_wait_frame() rather than touching its page or reverse map. */
+static size_t vm_write_out(struct frame **frames, size_t cnt) {
+    struct tlb_batch tlb;
+    size_t evicted = 0;
+    bool written[PAGEOUT_BATCH];
+
+    ASSERT(lock_held_by_current_thread(&frame_lock));
+    ASSERT(cnt <= PAGEOUT_BATCH);
+
+    /* Unmap first so the owners fault (and wait for the frame) instead
+     * of touching the pages while their contents are being written
+     * out. */
+    tlb_batch_init(&tlb);
+    busy_cnt += cnt;
+    for (size_t i = 0; i < cnt; i++) {
+        frames[i]->busy = true;
+        for (struct list_elem *e = list_begin(&frames[i]->rmap); e != list_end(&frames[i]->rmap);
+             e = list_next(e)) {
+            struct page *page = list_entry(e, struct page, rmap_elem);
+            pml4_unmap_page(page->owner->pml4, page->va, &tlb);
+        }
+    }
+    tlb_batch_flush(&tlb);
+
+    lock_release(&frame_lock);
+    for (size_t i = 0; i < cnt; i++)
+        written[i] = swap_out(frame_any_page(frames[i]));
+    lock_acquire(&frame_lock);
+
+    for (size_t i = 0; i < cnt; i++) {
+        struct frame *victim = frames[i];
+
+        victim->busy = false;
+        if (!written[i]) {
+            for (struct list_elem *e = list_begin(&victim->rmap); e != list_end(&victim->rmap);
+                 e = list_next(e)) {
+                struct page *page = list_entry(e, struct page, rmap_elem);
+                pml4_set_page(page->owner->pml4, page->va, victim->kva,
+                              page->writable && victim->ref_cnt == 1);
+            }
+            frame_table_insert(victim);
+            continue;
+        }
+        while (!list_empty(&victim->rmap))
+            frame_unlink(victim, frame_any_page(victim));
+        frames[evicted++] = victim;
+    }
+    busy_cnt -= cnt;
+    cond_broadcast(&frame_idle, &frame_lock);
+    return evicted;
+}
+
+/* Out-of-memory killer, for when no frame is free and none can be
+ * evicted.  Picks the process with the largest footprint, resident
+ * plus swapped pages, among those that map a frame in the table, and
+ * takes its frames back at once.  The process itself exits on its
+ * next fault.  Returns false, killing nothing, if the current process
+ * is the largest or there is no candidate left; the fault that needed
+ * the frame then fails as before.  FRAME_LOCK must be held. */
+static bool vm_oom_kill(void) {
+    struct thread *victim = NULL;
+    size_t victim_size = 0;
+
+    ASSERT(lock_held_by_current_thread(&frame_lock));
+    for (struct list_elem *e = list_begin(&frame_table); e != list_end(&frame_table);
+         e = list_next(e)) {
+        struct frame *frame = list_entry(e, struct frame, frame_elem);
+
+        for (struct list_elem *r = list_begin(&frame->rmap); r != list_end(&frame->rmap);
+             r = list_next(r)) {
+            struct thread *t = list_entry(r, struct page, rmap_elem)->owner;
+            size_t size = t->spt.resident_pages + t->spt.swapped_pages;
+
+            if (!t->spt.oom_killed && size > victim_size) {
+                victim = t;
+                victim_size = size;
+            }
+        }
+    }
+    if (victim == NULL || victim == thread_current())
+        return false;
+
+    victim->spt.oom_killed = true;
+    vmstat_oom_kill();
+    vm_oom_reclaim(victim);
+    return true;
+}
+
+/* Unmaps every unpinned frame of VICTIM, writing file pages back
+ * first, and frees the frames no other process shares.  The pages
+ * stay in VICTIM's table, now without contents, until it exits. */
+static void vm_oom_reclaim(struct thread *victim) {
+    struct tlb_batch tlb;
+    struct list freed;
+
+    tlb_batch_init(&tlb);
+    list_init(&freed);
+    for (struct list_elem *e = list_begin(&frame_table); e != list_end(&frame_table);) {
+        struct frame *frame = list_entry(e, struct frame, frame_elem);
+
+        e = list_next(e);
+        if (frame->pin_cnt > 0)
+            continue;
+        for (struct list_elem *r = list_begin(&frame->rmap); r != list_end(&frame->rmap);) {
+            struct page *page = list_entry(r, struct page, rmap_elem);
+
+            r = list_next(r);
+            if (page->owner != victim)
+                continue;
+            if (page_get_type(page) == VM_FILE)
+                file_backed_writeback(page);
+            if (victim->pml4 != NULL)
+                pml4_unmap_page(victim->pml4, page->va, &tlb);
+            frame_unlink(frame, page);
+        }
+        if (frame->ref_cnt == 0) {
+            frame_table_remove(frame);
+            list_push_back(&freed, &frame->frame_elem);
+        }
+    }
+    tlb_batch_flush(&tlb);
+
+    while (!list_empty(&freed))
+        vm_discard_frame(list_entry(list_pop_front(&freed), struct frame, frame_elem));
+}
+
+/* Picks a frame of the process that owns SPT to evict when it is at
+ * its resident limit: a second-chance sweep, like vm_get_victim(), but
+ * over the pages of SPT only.  The hand is the head of RESIDENT_LIST:
+ * each page looked at goes to the back, so the next call carries on
+ * where this one stopped and a page comes up again only after all the
+ * others.  Only frames that the process alone maps qualify, so that it
+ * never takes a frame from another process, and only frames that are
+ * mapped, which keeps out a frame still being filled by the fault that
+ * led here.  FRAME_LOCK must be held, and only the owner links pages
+ * without it, so the list stays put under us. */
+static struct frame *vm_get_local_victim(struct supplemental_page_table *spt) {
+    ASSERT(lock_held_by_current_thread(&frame_lock));
+    ASSERT(spt == &thread_current()->spt);
+
+    for (size_t n = 2 * spt->resident_pages; n > 0 && !list_empty(&spt->resident_list); n--) {
+        struct list_elem *e = list_pop_front(&spt->resident_list);
+        struct page *page = list_entry(e, struct page, resident_elem);
+        struct frame *frame = page->frame;
+
+        list_push_back(&spt->resident_list, e);
+        if (frame->busy || frame->ref_cnt != 1 || frame->pin_cnt > 0 ||
+            page->owner->pml4 == NULL || pml4_get_page(page->owner->pml4, page->va) != frame->kva ||
+            frame_test_and_clear_accessed(frame))
+            continue;
+        return frame;
+    }
+    return NULL;
+}
+
+/* Evicts one of the pages of SPT and returns its frame, or returns
+ * NULL if none can go.  FRAME_LOCK must be held; it is released while
+ * the page is written out. */
+static struct frame *vm_evict_local(struct supplemental_page_table *spt) {
+    struct frame *victim = vm_get_local_victim(spt);
+
+    if (victim == NULL)
+        return NULL;
+    frame_table_remove(victim);
+    return vm_write_out(&victim, 1) == 1 ? victim : NULL;
+}
+
+/* Sets the resident limit of the current process to PAGES, or lifts
+ * it if PAGES is 0.  The limit is inherited by children and kept
+ * across exec(); a process over it gives up its own pages as it needs
+ * new ones. */
+void vm_set_rss_limit(size_t pages) {
+    thread_current()->spt.rss_limit = pages;
+}
+
+/* Body of the page-out daemon. */
+static void vm_pageoutd(void *aux UNUSED) {
+    for (;;) {
+        sema_down(&pageout_sema);
+        for (size_t free_cnt; (free_cnt = palloc_free_cnt(PAL_USER)) < pageout_high;) {
+            struct frame *frames[PAGEOUT_BATCH];
+            size_t cnt = pageout_high - free_cnt < PAGEOUT_BATCH ? pageout_high - free_cnt
+                                                                 : PAGEOUT_BATCH;
+
+            lock_acquire(&frame_lock);
+            cnt = vm_evict_frames(frames, cnt);
+            lock_release(&frame_lock);
+            if (cnt == 0)
+                break;
+            for (size_t i = 0; i < cnt; i++)
+                vm_discard_frame(frames[i]);
+        }
+        pageout_woken = false;
+    }
+}
+
+/* Drops FRAME from the merging table if it is there. */
+static void ksm_forget(struct frame *frame) {
+    /* Another frame with the same checksum may be there instead. */
+    if (hash_find(&ksm_table, &frame->ksm_elem) == &frame->ksm_elem)
+        hash_delete(&ksm_table, &frame->ksm_elem);
+}
+
+/* Returns true if FRAME is private to one anonymous page, which could
+ * be moved onto another frame. */
+static bool ksm_mergeable(struct frame *frame) {
+    struct page *page = frame_any_page(frame);
+
+    return frame->ref_cnt == 1 && page != NULL && page->operations->type == VM_ANON &&
+           page->owner->pml4 != NULL;
+}
+
+/* Sets the mapping of the page that owns FRAME, if FRAME is private,
+ * read-only or back to what the page allows.  Shared frames are always
+ * mapped read-only. */
+static void ksm_protect(struct frame *frame, bool protect) {
+    struct page *page = frame_any_page(frame);
+
+    if (frame->ref_cnt == 1)
+        pml4_set_writable(page->owner->pml4, page->va, protect ? false : page->writable);
+}
+
+/* Moves the page on DROP, which must be mergeable, onto KEEP if their
+ * contents are equal, and frees DROP.  Both are write-protected first,
+ * so the comparison cannot race with a write; a later write to either
+ * page faults into vm_handle_wp() and un-shares it.  Returns true if
+ * the pages were merged. */
+static bool ksm_merge(struct frame *keep, struct frame *drop) {
+    struct page *page = frame_any_page(drop);
+
+    ASSERT(lock_held_by_current_thread(&frame_lock));
+
+    /* Write-protecting a pinned frame would make the kernel fault on
+     * it, and the fault would move the page off the frame. */
+    if (keep->pin_cnt > 0 || drop->pin_cnt > 0)
+        return false;
+    ksm_protect(keep, true);
+    ksm_protect(drop, true);
+    if (memcmp(keep->kva, drop->kva, PGSIZE) ||
+        !pml4_set_page(page->owner->pml4, page->va, keep->kva, false)) {
+        ksm_protect(keep, false);
+        ksm_protect(drop, false);
+        return false;
+    }
+
+    frame_unlink(drop, page);
+    frame_link(keep, page);
+    frame_table_remove(drop);
+    vm_discard_frame(drop);
+    ksm_merged++;
+    return true;
+}
+
+/* Checksums FRAME and merges it with a frame of equal contents seen
+ * earlier in the sweep, if there is one and either can be moved. */
+static void ksm_scan_frame(struct frame *frame) {
+    struct page *page = frame_any_page(frame);
+    struct hash_elem *e;
+    struct frame *other;
+
+    /* Frames always hold anonymous pages when shared.  Huge pages are
+     * left whole: write-protecting a page would split its mapping. */
+    if (page == NULL || page->operations->type != VM_ANON || page->owner->pml4 == NULL ||
+        pml4_is_huge(page->owner->pml4, page->va))
+        return;
+
+    ksm_forget(frame);
+    frame->ksm_sum = hash_bytes(frame->kva, PGSIZE);
+    e = hash_insert(&ksm_table, &frame->ksm_elem);
+    if (e == NULL)
+        return;
+
+    other = hash_entry(e, struct frame, ksm_elem);
+    if (ksm_mergeable(frame))
+        ksm_merge(other, frame);
+    else if (ksm_mergeable(other) && ksm_merge(frame, other))
+        hash_insert(&ksm_table, &frame->ksm_elem);
+}
+
+/* Body of the same-page merging daemon.  It runs at the lowest
+ * priority, so it only takes time nobody else wants. */
+static void vm_ksmd(void *aux UNUSED) {
+    for (;;) {
+        timer_sleep(KSM_SLEEP_TICKS);
+        lock_acquire(&frame_lock);
+        for (size_t i = 0; i < KSM_SCAN_BATCH && !list_empty(&frame_table); i++) {
+            /* Contents seen in an earlier sweep may have changed since:
+             * start every sweep afresh. */
+            if (ksm_cursor == NULL) {
+                hash_clear(&ksm_table, NULL);
+                ksm_cursor = list_begin(&frame_table);
+            }
+
+            struct frame *frame = list_entry(ksm_cursor, struct frame, frame_elem);
+            ksm_cursor = list_next(ksm_cursor);
+            if (ksm_cursor == list_end(&frame_table))
+                ksm_cursor = NULL;
+            ksm_scan_frame(frame);
+        }
+        lock_release(&frame_lock);
+    }
+}
+
+/* Returns the merging table hash of a frame: its checksum. */
+static uint64_t ksm_hash(const struct hash_elem *e, void *aux UNUSED) {
+    return hash_entry(e, struct frame, ksm_elem)->ksm_sum;
+}
+
+/* Orders frames in the merging table by checksum. */
+static bool ksm_less(const struct hash_elem *a, const struct hash_elem *b, void *aux UNUSED) {
+    return hash_entry(a, struct frame, ksm_elem)->ksm_sum <
+           hash_entry(b, struct frame, ksm_elem)->ksm_sum;
+}
+
+/* Computes into the text fields of KEY the shared text key of VA in
+ * SPT.  Returns false if VA is not shared text: a page of a read-only
+ * anonymous region that takes at least some of its bytes from a file,
+ * which is to say a page of program text or read-only data.  The
+ * executable cannot change under such a page, since it is denied
+ * writes while it runs. */
+static bool text_key(struct supplemental_page_table *spt, void *va, struct frame *key) {
+    struct vma *vma = vma_find(spt, va);
+    size_t ofs;
+
+    if (vma == NULL || VM_TYPE(vma->type) != VM_ANON || vma->writable || vma->file == NULL)
+        return false;
+    ofs = (uint8_t *)va - (uint8_t *)vma->start;
+    if (ofs >= vma->read_bytes)
+        return false;
+    key->text_sector = inode_get_inumber(file_get_inode(vma->file));
+    key->text_ofs = vma->ofs + ofs;
+    key->text_len = vma->read_bytes - ofs < PGSIZE ? vma->read_bytes - ofs : PGSIZE;
+    return true;
+}
+
+/* Enters FRAME, just filled for PAGE, in the shared text table if PAGE
+ * is shared text and no other frame holds it already.  FRAME_LOCK must
+ * be held. */
+static void text_publish(struct frame *frame, struct page *page) {
+    ASSERT(lock_held_by_current_thread(&frame_lock));
+
+    if (!page->writable && text_key(&page->owner->spt, page->va, frame))
+        hash_insert(&text_table, &frame->text_elem);
+}
+
+/* Drops FRAME from the shared text table if it is there. */
+static void text_forget(struct frame *frame) {
+    /* Another frame with the same key may be there instead. */
+    if (hash_find(&text_table, &frame->text_elem) == &frame->text_elem)
+        hash_delete(&text_table, &frame->text_elem);
+}
+
+/* Hashes the shared text key of a frame. */
+static uint64_t text_hash(const struct hash_elem *e, void *aux UNUSED) {
+    const struct frame *frame = hash_entry(e, struct frame, text_elem);
+    return hash_int(frame->text_sector) ^ hash_int(frame->text_ofs);
+}
+
+/* Orders frames in the shared text table by key. */
+static bool text_less(const struct hash_elem *a_, const struct hash_elem *b_, void *aux UNUSED) {
+    const struct frame *a = hash_entry(a_, struct frame, text_elem);
+    const struct frame *b = hash_entry(b_, struct frame, text_elem);
+
+    if (a->text_sector != b->text_sector)
+        return a->text_sector < b->text_sector;
+    if (a->text_ofs != b->text_ofs)
+        return a->text_ofs < b->text_ofs;
+    return a->text_len < b->text_len;
+}
+
 /* palloc() and get frame. If there is no available page, evict the page
   and return it. This always return valid address. That is, if the user pool
   memory is full, this function evicts the frame to get the available memory
   space.*/
 static struct frame *vm_get_frame(void) {
+    struct supplemental_page_table *spt = &thread_current()->spt;
     struct frame *frame = NULL;
-    /* TODO: Fill this function. */
-    frame = calloc(1, sizeof(struct frame));  // malloc + memset 0
-    frame->page = NULL;
-    if (frame == NULL)
+    void *kva;
+
+    /* A process at its resident limit makes room among its own pages
+     * instead of taking a frame from the pool.  If none of them can
+     * go, it gets a frame like anyone else: the limit is a soft one. */
+    if (spt->rss_limit != 0 && spt->resident_pages >= spt->rss_limit) {
+        lock_acquire(&frame_lock);
+        frame = vm_evict_local(spt);
+        lock_release(&frame_lock);
+        if (frame != NULL) {
+            memset(frame->kva, 0, PGSIZE);
+            return frame;
+        }
+    }
+
+    kva = palloc_get_page(PAL_USER | PAL_ZERO);
+
+    if (!pageout_woken && palloc_free_cnt(PAL_USER) < pageout_low) {
+        pageout_woken = true;
+        sema_up(&pageout_sema);
+    }
+
+    while (kva == NULL) {
+        bool killed = false, waited = false;
+
+        lock_acquire(&frame_lock);
+        frame = vm_evict_frame();
+        if (frame == NULL && busy_cnt > 0) {
+            /* Frames being written out elsewhere are about to be
+             * freed; no one needs to be killed for them. */
+            cond_wait(&frame_idle, &frame_lock);
+            waited = true;
+        } else if (frame == NULL)
+            killed = vm_oom_kill();
+        lock_release(&frame_lock);
+        if (frame != NULL) {
+            memset(frame->kva, 0, PGSIZE);
+            return frame;
+        }
+        if (!killed && !waited)
+            return NULL;
+        kva = palloc_get_page(PAL_USER | PAL_ZERO);
+    }
+
+    frame = vm_frame_lookup(kva);
+    ASSERT(frame->ref_cnt == 0 && frame->pin_cnt == 0);
+    return frame;
+}
+
+/* Starts the heap of SPT, empty, right above its highest region.
+ * Called by load() once the program's segments are in place, so the
+ * heap follows the end of its data. */
+void vm_heap_init(struct supplemental_page_table *spt) {
+    void *start = NULL;
+
+    if (!list_empty(&spt->vma_list))
+        start = list_entry(list_back(&spt->vma_list), struct vma, elem)->end;
+    spt->heap_start = spt->brk = start;
+}
+
+/* Moves the break of the current process, the end of its heap, by
+ * INCREMENT bytes and returns the old break, or returns NULL if the
+ * heap would shrink past its start or cannot grow that far.  Growing
+ * only extends the heap region, whose pages are made on first touch
+ * like the stack's; shrinking frees the pages past the new break at
+ * once, swap slots included. */
+void *vm_sbrk(intptr_t increment) {
+    struct supplemental_page_table *spt = &thread_current()->spt;
+    uint8_t *old_brk = spt->brk, *new_brk = old_brk + increment;
+    void *old_end = pg_round_up(old_brk), *new_end = pg_round_up(new_brk);
+    struct vma *heap = old_end > spt->heap_start ? vma_find(spt, old_end - PGSIZE) : NULL;
+
+    if (spt->heap_start == NULL || (increment < 0 && new_brk > old_brk) ||
+        (increment > 0 && new_brk < old_brk) || new_brk < (uint8_t *)spt->heap_start ||
+        new_brk > (uint8_t *)USER_STACK - STACK_MAX)
         return NULL;
-    if ((frame->kva = palloc_get_page(PAL_USER | PAL_ZERO)) == NULL)
+
+    if (new_end > old_end) {
+        if (!vma_is_free(spt, old_end, new_end))
+            return NULL;
+        if (heap != NULL)
+            heap->end = new_end;
+        else if (vma_create(spt, spt->heap_start, new_end, VM_ANON, true, NULL, 0, 0, NULL) ==
+                 NULL)
+            return NULL;
+    } else if (new_end < old_end) {
+        spt_remove_range(spt, new_end, old_end);
+        if (new_end == spt->heap_start)
+            vma_destroy(spt, heap);
+        else
+            heap->end = new_end;
+    }
+    spt->brk = new_brk;
+    return old_brk;
+}
+
+/* Growing the stack: extends the stack region of SPT down to ADDR.
+ * The page itself is created by the caller like any other. */
+static bool vm_stack_growth(struct supplemental_page_table *spt, void *addr) {
+    struct vma *stack = vma_find(spt, (void *)USER_STACK - PGSIZE);
+
+    if (stack == NULL || !vma_is_free(spt, addr, stack->start))
+        return false;
+    stack->start = addr;
+    spt->vma_cache = stack;
+    return true;
+}
+
+/* Creates the page for VA in SPT from the region that covers VA.
+ * Returns NULL if VA lies in no region. */
+static struct page *vm_instantiate_page(struct supplemental_page_table *spt, void *va) {
+    struct vma *vma = vma_find(spt, va);
+
+    if (vma == NULL ||
+        !vm_alloc_page_with_initializer(vma->type, va, vma->writable, vma->init, vma))
         return NULL;
-    // PANIC("todo");
-    ASSERT(frame != NULL);
-    ASSERT(frame->page == NULL);
-    return frame;
+    return spt_find_page(spt, va);
+}
+
+/* Maps the shared zero frame read-only at VA, for a read fault on an
+ * untouched page whose contents would be all zeros: an anonymous page
+ * past the file-backed part of its region (BSS, the stack).  Returns
+ * false if VA does not qualify or memory is short; the caller then
+ * takes the normal path. */
+static bool vm_map_zero_page(struct supplemental_page_table *spt, void *va) {
+    struct vma *vma = vma_find(spt, va);
+
+    if (vma == NULL || VM_TYPE(vma->type) != VM_ANON ||
+        va < pg_round_up(vma->start + vma->read_bytes))
+        return false;
+
+    struct page *page = calloc(1, sizeof(struct page));
+    if (page == NULL)
+        return false;
+    page->va = va;
+    page->writable = vma->writable;
+    page->owner = thread_current();
+    anon_initializer(page, vma->type, NULL);
+
+    lock_acquire(&frame_lock);
+    if (!pml4_set_page(page->owner->pml4, va, zero_frame->kva, false)) {
+        lock_release(&frame_lock);
+        free(page);
+        return false;
+    }
+    frame_link(zero_frame, page);
+    lock_release(&frame_lock);
+
+    spt_insert_page(spt, page);
+    return true;
+}
+
+/* Maps at VA the frame that another process already holds the same
+ * page of program text in, for a read fault on an untouched page.
+ * Returns false if VA is not shared text or no frame holds it; the
+ * caller then reads the page itself, which enters its frame in the
+ * table for the next process. */
+static bool vm_map_text_page(struct supplemental_page_table *spt, void *va) {
+    struct frame key;
+    struct hash_elem *e;
+
+    if (!text_key(spt, va, &key))
+        return false;
+
+    struct page *page = calloc(1, sizeof(struct page));
+    if (page == NULL)
+        return false;
+    page->va = va;
+    page->writable = false;
+    page->owner = thread_current();
+    anon_initializer(page, VM_ANON, NULL);
+
+    lock_acquire(&frame_lock);
+    e = hash_find(&text_table, &key.text_elem);
+    if (e == NULL ||
+        !pml4_set_page(page->owner->pml4, va, hash_entry(e, struct frame, text_elem)->kva, false)) {
+        lock_release(&frame_lock);
+        free(page);
+        return false;
+    }
+    frame_link(hash_entry(e, struct frame, text_elem), page);
+    text_shared++;
+    lock_release(&frame_lock);
+
+    spt_insert_page(spt, page);
+    return true;
+}
+
+/* Backs the HPGSIZE-aligned block of user memory around VA with one
+ * huge page: HPGCNT physically contiguous frames mapped by a single
+ * page directory entry, which saves TLB entries on large buffers.
+ * Only done on a write fault, since a read of untouched memory is
+ * served by the shared zero frame at no cost, and only when the block
+ * lies wholly in the zero-filled part of an anonymous region, none of
+ * its pages exists yet, and the user pool has the frames to spare.  Each page still gets its own struct page
+ * and frame, so eviction and copy-on-write work as usual; the mapping
+ * is split when they touch a single page. */
+static bool vm_map_huge_page(struct supplemental_page_table *spt, void *va) {
+    void *start = (void *)((uint64_t)va & ~(HPGSIZE - 1));
+    struct vma *vma = vma_find(spt, va);
+    struct list frames;
+    uint8_t *kva;
+
+    if (vma == NULL || VM_TYPE(vma->type) != VM_ANON || (vma->type & VM_STACK) ||
+        start < pg_round_up(vma->start + vma->read_bytes) || start + HPGSIZE > vma->end ||
+        palloc_free_cnt(PAL_USER) < HPGCNT + pageout_high ||
+        (spt->rss_limit != 0 && spt->resident_pages + HPGCNT > spt->rss_limit))
+        return false;
+
+    /* Touched neighbours are the likely reason to fail, so look there
+     * first. */
+    if ((va != start && spt_find_page(spt, va - PGSIZE) != NULL) ||
+        (va + PGSIZE != start + HPGSIZE && spt_find_page(spt, va + PGSIZE) != NULL))
+        return false;
+    for (void *p = start; p < start + HPGSIZE; p += PGSIZE)
+        if (spt_find_page(spt, p) != NULL)
+            return false;
+
+    kva = palloc_get_multiple_aligned(PAL_USER | PAL_ZERO, HPGCNT, HPGSIZE);
+    if (kva == NULL)
+        return false;
+
+    list_init(&frames);
+    for (size_t i = 0; i < HPGCNT; i++) {
+        struct page *page = calloc(1, sizeof(struct page));
+        struct frame *frame = vm_frame_lookup(kva + i * PGSIZE);
+        if (page == NULL)
+            goto fail;
+        page->va = start + i * PGSIZE;
+        page->writable = vma->writable;
+        page->owner = thread_current();
+        anon_initializer(page, vma->type, NULL);
+        frame_link(frame, page);
+        list_push_back(&frames, &frame->frame_elem);
+    }
+
+    lock_acquire(&frame_lock);
+    if (!pml4_set_huge_page(thread_current()->pml4, start, kva, vma->writable)) {
+        lock_release(&frame_lock);
+        goto fail;
+    }
+    while (!list_empty(&frames)) {
+        struct frame *frame = list_entry(list_pop_front(&frames), struct frame, frame_elem);
+        spt_insert_page(spt, frame_any_page(frame));
+        frame_table_insert(frame);
+    }
+    lock_release(&frame_lock);
+    return true;
+
+fail:
+    while (!list_empty(&frames)) {
+        struct frame *frame = list_entry(list_pop_front(&frames), struct frame, frame_elem);
+        struct page *page = frame_any_page(frame);
+        frame_unlink(frame, page);
+        free(page);
+    }
+    palloc_free_multiple(kva, HPGCNT);
+    return false;
 }
 
-//
-/* Growing the stack. */
-static void vm_stack_growth(void *addr) {
-    vm_alloc_page_with_initializer(VM_ANON | VM_STACK, addr, true, NULL, NULL);
-    if (!vm_claim_page(addr)) {
-        msg("stack_grows error");
+/* Frees FRAME, which is not in the frame table and maps no page. */
+static void vm_discard_frame(struct frame *frame) {
+    ASSERT(frame->ref_cnt == 0);
+    palloc_free_page(frame->kva);
+}
+
+/* Handle the fault on write_protected page.
+ * A write to a writable page that faults on protection is a write to a
+ * frame shared copy-on-write, or to the zero frame.  The last page left
+ * on a frame simply takes it over; otherwise the page gets a private
+ * copy. */
+static bool vm_handle_wp(struct page *page) {
+    struct frame *old, *new;
+
+    if (!page->writable)
+        return false;
+
+    lock_acquire(&frame_lock);
+    vm_wait_frame(page);
+    old = page->frame;
+    if (old == NULL) {
+        lock_release(&frame_lock);
+        return vm_do_claim_page(page);
+    }
+    if (old->ref_cnt == 1) {
+        pml4_set_writable(page->owner->pml4, page->va, true);
+        lock_release(&frame_lock);
+        return true;
+    }
+    lock_release(&frame_lock);
+
+    /* Getting a frame may evict, which takes FRAME_LOCK itself. */
+    new = vm_get_frame();
+    if (new == NULL)
+        return false;
+
+    lock_acquire(&frame_lock);
+    vm_wait_frame(page);
+    old = page->frame;
+    if (old == NULL) {
+        /* OLD was evicted in the meantime; the page now comes back from
+         * swap as a private copy. */
+        lock_release(&frame_lock);
+        vm_discard_frame(new);
+        return vm_do_claim_page(page);
+    }
+    if (old->ref_cnt == 1) {
+        /* The other sharers went away while we were allocating. */
+        pml4_set_writable(page->owner->pml4, page->va, true);
+        lock_release(&frame_lock);
+        vm_discard_frame(new);
+        return true;
     }
+
+    if (!pml4_set_page(page->owner->pml4, page->va, new->kva, true)) {
+        lock_release(&frame_lock);
+        vm_discard_frame(new);
+        return false;
+    }
+    if (old != zero_frame)
+        memcpy(new->kva, old->kva, PGSIZE);
+    frame_unlink(old, page);
+    frame_link(new, page);
+    frame_table_insert(new);
+    lock_release(&frame_lock);
+    return true;
 }
 
-/* Handle the fault on write_protected page */
-static bool vm_handle_wp(struct page *page UNUSED) {}
+/* Returns the class of a fault at VA, which PAGE, if not null, covers
+ * and is not resident. */
+static enum vm_fault_class vm_fault_class(struct supplemental_page_table *spt, void *va,
+                                          struct page *page) {
+    struct vma *vma;
+
+    if (page != NULL && page->operations->type != VM_UNINIT)
+        return page->operations->type == VM_ANON ? VM_FAULT_SWAP : VM_FAULT_FILE;
+
+    vma = vma_find(spt, va);
+    if (vma == NULL)
+        return VM_FAULT_ZERO;
+    if (vma->type & VM_STACK)
+        return VM_FAULT_STACK;
+    if (VM_TYPE(vma->type) == VM_FILE || va < vma->start + vma->read_bytes)
+        return VM_FAULT_FILE;
+    return VM_FAULT_ZERO;
+}
+
+/* Does the work of vm_try_handle_fault(), and sets *CLASS to the class
+ * of the fault, or to VM_FAULT_CLASS_CNT if there was nothing to do. */
+static bool vm_handle_fault(struct intr_frame *f, void *addr, bool user, bool write,
+                            bool not_present, enum vm_fault_class *class) {
+    struct supplemental_page_table *spt = &thread_current()->spt;
+    void *addr_rd = pg_round_down(addr);
+
+    *class = VM_FAULT_CLASS_CNT;
+    if (addr == NULL || !is_user_vaddr(addr) || spt->oom_killed)
+        return false;
 
-/* Return true on success */
-bool vm_try_handle_fault(struct intr_frame *f UNUSED, void *addr UNUSED, bool user UNUSED,
-                         bool write UNUSED, bool not_present UNUSED) {
-    struct supplemental_page_table *spt UNUSED = &thread_current()->spt;
-    uint64_t addr_rd = pg_round_down(addr);
     struct page *page = spt_find_page(spt, addr_rd);
 
     /* TODO: Validate the fault */
-    if (page != NULL) {
-        return vm_do_claim_page(page);
-    } else if (USER_STACK > addr_rd && addr_rd > (USER_STACK - (1 << 20)) &&
-               addr >= (void *)f->rsp - 8) {
-        vm_stack_growth(addr_rd);
+    if (!not_present) {
+        if (page == NULL || !write)
+            return false;
+        *class = page->frame == zero_frame ? VM_FAULT_ZERO : VM_FAULT_COW;
+        return vm_handle_wp(page);
+    }
+
+    if (page == NULL) {
+        /* Kernel faults happen inside system calls, where F->rsp is the
+         * kernel stack; use the user rsp saved on syscall entry. */
+        void *rsp = user ? (void *)f->rsp : thread_current()->user_rsp;
+
+        if (vma_find(spt, addr_rd) == NULL && (void *)USER_STACK > addr_rd &&
+            addr_rd > (void *)(USER_STACK - STACK_MAX) && addr >= rsp - 8 &&
+            !vm_stack_growth(spt, addr_rd))
+            return false;
+        *class = vm_fault_class(spt, addr_rd, NULL);
+        if (write && vm_map_huge_page(spt, addr_rd))
+            return true;
+        if (!write && vm_map_zero_page(spt, addr_rd))
+            return true;
+        if (!write && vm_map_text_page(spt, addr_rd))
+            return true;
+        page = vm_instantiate_page(spt, addr_rd);
+        if (page == NULL)
+            return false;
+    } else
+        *class = vm_fault_class(spt, addr_rd, page);
+
+    if (write && !page->writable)
+        return false;
+
+    /* The page may be in the middle of being evicted by another
+     * thread; once that is over it is either resident again or fully
+     * swapped out. */
+    lock_acquire(&frame_lock);
+    vm_wait_frame(page);
+    bool resident = page->frame != NULL;
+    lock_release(&frame_lock);
+    if (resident) {
+        *class = VM_FAULT_CLASS_CNT;
         return true;
     }
-    return false;
+    if (!vm_do_claim_page(page))
+        return false;
+    vm_drop_behind(spt, addr_rd);
+    return true;
+}
+
+/* Return true on success.
+ * Each fault resolved is counted, with its cost, under its class. */
+bool vm_try_handle_fault(struct intr_frame *f, void *addr, bool user, bool write,
+                         bool not_present) {
+    uint64_t start = vmstat_begin();
+    enum vm_fault_class class;
+
+    if (!vm_handle_fault(f, addr, user, write, not_present, &class))
+        return false;
+    if (class != VM_FAULT_CLASS_CNT)
+        vmstat_end(class, start);
+    return true;
+}
+
+/* Pages that a fault in VMA reads ahead, itself included. */
+size_t vm_readahead_pages(const struct vma *vma) {
+    size_t window = fault_around_pages > 0 ? fault_around_pages : 1;
+
+    if (vma->advice == MADV_SEQUENTIAL)
+        window *= SEQUENTIAL_READAHEAD_SCALE;
+    return window;
+}
+
+/* After a fault at VA in a region advised MADV_SEQUENTIAL, hands the
+ * pages the reader has moved past, the readahead window before the
+ * previous one, to the clock hand to evict first.  A scan then pushes
+ * out its own pages rather than everyone else's.  Shared and pinned
+ * frames are left alone. */
+static void vm_drop_behind(struct supplemental_page_table *spt, void *va) {
+    struct vma *vma = vma_find(spt, va);
+    size_t window;
+
+    if (vma == NULL || vma->advice != MADV_SEQUENTIAL)
+        return;
+    window = vm_readahead_pages(vma) * PGSIZE;
+    if ((size_t)(va - vma->start) < 2 * window)
+        return;
+
+    lock_acquire(&frame_lock);
+    for (void *p = va - 2 * window; p < va - window; p += PGSIZE) {
+        struct page *page = spt_find_page(spt, p);
+        struct frame *frame = page != NULL ? page->frame : NULL;
+
+        if (frame != NULL && frame != zero_frame && !frame->busy && frame->ref_cnt == 1 &&
+            frame->pin_cnt == 0)
+            frame_table_deactivate(frame);
+    }
+    lock_release(&frame_lock);
+}
+
+/* Applies ADVICE, an enum vm_advice, to [ADDR, ADDR + LENGTH) of the
+ * current process, which must be page aligned and lie wholly inside
+ * its regions.  Returns 0 on success, -1 on bad arguments.
+ *
+ * - MADV_NORMAL and MADV_SEQUENTIAL are recorded in every region the
+ *   range touches, in the whole region: regions are never split.
+ * - MADV_WILLNEED faults in the pages that would have to be read,
+ *   from a file or from swap, a readahead window or swap cluster at a
+ *   time, so that later accesses do not wait on the disk.  It is done
+ *   before returning, since only the owner may add pages to its table,
+ *   and it stops short of forcing evictions for the sake of a hint.
+ *   The pages come in by the fault path but are not counted as faults,
+ *   so that the counters show what the hint saved.
+ * - MADV_DONTNEED drops the pages at once, freeing their frames and
+ *   swap slots; file mapped pages are written back first.  Touched
+ *   again, the pages read as they would the first time: zeros, or the
+ *   file's contents. */
+int vm_madvise(void *addr, size_t length, int advice) {
+    struct supplemental_page_table *spt = &thread_current()->spt;
+    void *end = addr + length;
+
+    if (pg_ofs(addr) != 0 || end < addr || !is_user_vaddr(addr) ||
+        (length > 0 && !is_user_vaddr(end - 1)))
+        return -1;
+    end = pg_round_up(end);
+    for (void *va = addr; va < end;) {
+        struct vma *vma = vma_find(spt, va);
+        if (vma == NULL)
+            return -1;
+        va = vma->end;
+    }
+
+    switch (advice) {
+        case MADV_NORMAL:
+        case MADV_SEQUENTIAL:
+            for (void *va = addr; va < end;) {
+                struct vma *vma = vma_find(spt, va);
+                vma->advice = advice;
+                va = vma->end;
+            }
+            return 0;
+        case MADV_WILLNEED:
+            for (void *va = addr; va < end && palloc_free_cnt(PAL_USER) > pageout_high;
+                 va += PGSIZE) {
+                struct vma *vma = vma_find(spt, va);
+                struct page *page = spt_find_page(spt, va);
+                enum vm_fault_class class;
+                bool absent;
+
+                lock_acquire(&frame_lock);
+                absent = page != NULL ? page->frame == NULL
+                                      : vma->file != NULL &&
+                                            (size_t)(va - vma->start) < vma->read_bytes;
+                lock_release(&frame_lock);
+                if (absent)
+                    vm_handle_fault(NULL, va, false, false, true, &class);
+            }
+            return 0;
+        case MADV_DONTNEED:
+            spt_remove_range(spt, addr, end);
+            return 0;
+        default:
+            return -1;
+    }
+}
+
+/* Faults in the pages of the current process that cover
+ * [START, START + SIZE), writable ones if WRITE is set, and pins their
+ * frames, so that they are neither evicted nor moved until
+ * vm_unpin_range().  System calls use this to copy to and from user
+ * buffers in bulk without faulting midway.  Returns false, with
+ * nothing pinned, if the process may not access the whole range that
+ * way. */
+bool vm_pin_range(const void *start, size_t size, bool write) {
+    void *first = pg_round_down(start);
+    void *end = (void *)start + size;
+
+    if (size == 0)
+        return true;
+    if (end < start || !is_user_vaddr(end - 1))
+        return false;
+
+    for (void *va = first; va < end; va += PGSIZE) {
+        if (!vm_pin_page(va, write)) {
+            while (va > first)
+                vm_unpin_page(va -= PGSIZE);
+            return false;
+        }
+    }
+    return true;
+}
+
+/* Releases the pins taken by vm_pin_range() on the same range. */
+void vm_unpin_range(const void *start, size_t size) {
+    void *end = (void *)start + size;
+
+    for (void *va = pg_round_down(start); va < end; va += PGSIZE)
+        vm_unpin_page(va);
+}
+
+/* Pins the frame of the page at VA, faulting the page in first, and
+ * breaking any copy-on-write sharing if WRITE is set. */
+static bool vm_pin_page(void *va, bool write) {
+    struct supplemental_page_table *spt = &thread_current()->spt;
+
+    for (;;) {
+        lock_acquire(&frame_lock);
+        struct page *page = spt_find_page(spt, va);
+        if (page != NULL)
+            vm_wait_frame(page);
+        bool not_present = page == NULL || page->frame == NULL;
+        if (!not_present && (!write || pml4_is_writable(page->owner->pml4, va))) {
+            page->frame->pin_cnt++;
+            lock_release(&frame_lock);
+            return true;
+        }
+        lock_release(&frame_lock);
+
+        /* The page may be evicted again before we get the lock back;
+         * then we just go around once more. */
+        if (!vm_try_handle_fault(NULL, va, false, write, not_present))
+            return false;
+    }
+}
+
+/* Releases a pin that vm_pin_page() took on the page at VA. */
+static void vm_unpin_page(void *va) {
+    lock_acquire(&frame_lock);
+    struct page *page = spt_find_page(&thread_current()->spt, va);
+    ASSERT(page != NULL && page->frame != NULL && page->frame->pin_cnt > 0);
+    page->frame->pin_cnt--;
+    lock_release(&frame_lock);
 }
 
 /* Free the page.
@@ -186,61 +1599,190 @@ void vm_dealloc_page(struct page *page) {
 bool vm_claim_page(void *va) {
     struct page *page = NULL;
     /* TODO: Fill this function */
-    page = spt_find_page(&thread_current()->spt, va);
+    struct supplemental_page_table *spt = &thread_current()->spt;
+
+    page = spt_find_page(spt, va);
+    if (page == NULL)
+        page = vm_instantiate_page(spt, pg_round_down(va));
+    if (page == NULL)
+        return false;
 
     return vm_do_claim_page(page);
 }
 
-/* Claim the PAGE and set up the mmu. */
+/* Initializer for pages whose contents are already at hand: AUX
+ * points to a page worth of bytes. */
+static bool vm_fill_page(struct page *page, void *aux) {
+    memcpy(page->frame->kva, aux, PGSIZE);
+    return true;
+}
+
+/* Claims the page at VA, which must lie in a region of the current
+ * process and not have been touched yet, copying its contents from
+ * CONTENTS instead of running the region's initializer.  Used to
+ * populate pages ahead of their first fault. */
+bool vm_claim_page_with(void *va, const void *contents) {
+    return vm_claim_page_init(va, vm_fill_page, (void *)contents);
+}
+
+/* Like vm_claim_page_with(), but fills the page by running INIT with
+ * AUX, for callers that have more to set up than the contents. */
+bool vm_claim_page_init(void *va, vm_initializer *init, void *aux) {
+    struct supplemental_page_table *spt = &thread_current()->spt;
+    struct vma *vma = vma_find(spt, va);
+    struct page *page;
+
+    if (vma == NULL || spt_find_page(spt, va) != NULL)
+        return false;
+    if (vm_map_text_page(spt, va))
+        return true;
+    if (!vm_alloc_page_with_initializer(vma->type, va, vma->writable, init, aux))
+        return false;
+
+    page = spt_find_page(spt, va);
+    if (vm_do_claim_page(page))
+        return true;
+
+    /* Don't leave behind a page whose initializer points at AUX. */
+    spt_remove_page(spt, page);
+    return false;
+}
+
+/* Claim the PAGE and set up the mmu.
+ * The frame only joins the frame table once its contents are in place
+ * and the mapping is installed, so eviction never sees a half-built
+ * page. */
 static bool vm_do_claim_page(struct page *page) {
+    return vm_claim_page_from(page, NULL);
+}
+
+/* Claims PAGE like vm_do_claim_page(), except that if CONTENTS is not
+ * null the frame is filled from it and the page's swap_in is skipped.
+ * PAGE must already be initialized.  Used by swap readahead, which
+ * has the contents in hand and releases the backing itself. */
+bool vm_claim_page_from(struct page *page, const void *contents) {
     struct frame *frame = vm_get_frame();
+    if (frame == NULL)
+        return false;
 
     /* Set links */
-    frame->page = page;
-    page->frame = frame;
+    frame_link(frame, page);
+
+    if (contents != NULL)
+        memcpy(frame->kva, contents, PGSIZE);
+    else if (!swap_in(page, frame->kva)) {
+        frame_unlink(frame, page);
+        vm_discard_frame(frame);
+        return false;
+    }
 
     /* TODO: Insert page table entry to map page's VA to frame's PA. */
-    if (!pml4_set_page(thread_current()->pml4, page->va, frame->kva, page->writable))
+    if (!pml4_set_page(page->owner->pml4, page->va, frame->kva, page->writable)) {
+        frame_unlink(frame, page);
+        vm_discard_frame(frame);
         return false;
+    }
 
-    return swap_in(page, frame->kva);
+    lock_acquire(&frame_lock);
+    frame_table_insert(frame);
+    text_publish(frame, page);
+    lock_release(&frame_lock);
+    return true;
 }
 
 /* Initialize new supplemental page table */
 void supplemental_page_table_init(struct supplemental_page_table *spt UNUSED) {
     hash_init(&spt->spt_hash_table, page_hash, page_less, NULL);
+    vma_init(spt);
+    spt->swap_hint_va = NULL;
+    spt->swap_hint_slot = SWAP_SLOT_NONE;
+    spt->resident_pages = 0;
+    spt->swapped_pages = 0;
+    spt->peak_resident_pages = 0;
+    spt->rss_limit = 0;
+    list_init(&spt->resident_list);
+    spt->oom_killed = false;
+    spt->heap_start = NULL;
+    spt->brk = NULL;
+}
+
+/* Adds RESIDENT and SWAPPED, either of which may be negative, to the
+ * footprint of SPT.  Pages are linked to frames and swapped out by
+ * other threads, not always under FRAME_LOCK, so interrupts are turned
+ * off for the update. */
+void spt_account(struct supplemental_page_table *spt, int resident, int swapped) {
+    enum intr_level old_level = intr_disable();
+    spt->resident_pages += resident;
+    spt->swapped_pages += swapped;
+    if (spt->resident_pages > spt->peak_resident_pages)
+        spt->peak_resident_pages = spt->resident_pages;
+    intr_set_level(old_level);
+}
+
+/* Adds to DST, the current thread's table, an anonymous page that
+ * shares SRC's contents copy-on-write.  If SRC is in memory, its frame
+ * is shared and both mappings are made read-only; the first write to
+ * either one faults into vm_handle_wp().  If it is in swap, the child
+ * takes a reference to its slot instead, so that fork neither reads
+ * the parent's swap back in nor needs frames to do it. */
+static bool vm_share_page(struct supplemental_page_table *dst, struct page *src) {
+    struct page *page = calloc(1, sizeof(struct page));
+    if (page == NULL)
+        return false;
+
+    page->va = src->va;
+    page->writable = src->writable;
+    page->owner = thread_current();
+    anon_initializer(page, VM_ANON, NULL);
+
+    lock_acquire(&frame_lock);
+    vm_wait_frame(src);
+    struct frame *frame = src->frame;
+    if (frame == NULL)
+        anon_share_slot(page, src);
+    else {
+        if (!pml4_set_page(page->owner->pml4, page->va, frame->kva, false)) {
+            lock_release(&frame_lock);
+            free(page);
+            return false;
+        }
+        pml4_set_writable(src->owner->pml4, src->va, false);
+        frame_link(frame, page);
+    }
+    lock_release(&frame_lock);
+
+    hash_insert(&dst->spt_hash_table, &page->hash_elem);
+    return true;
 }
 
-/* Copy supplemental page table from src to dst */
-bool supplemental_page_table_copy(struct supplemental_page_table *dst UNUSED,
-                                  struct supplemental_page_table *src UNUSED) {
+/* Copy supplemental page table from src to dst.
+ * Regions are copied whole; of the pages, only anonymous ones carry
+ * state that the regions do not, and those are shared copy-on-write.
+ * File mapped pages are written back so that the child, which reads
+ * them afresh, sees the parent's changes.  Pages still uninitialized
+ * are rebuilt from the child's regions. */
+bool supplemental_page_table_copy(struct supplemental_page_table *dst,
+                                  struct supplemental_page_table *src) {
     struct hash_iterator i;
+
+    dst->rss_limit = src->rss_limit;
+    dst->heap_start = src->heap_start;
+    dst->brk = src->brk;
+    if (!vma_copy(dst, src))
+        return false;
+
     hash_first(&i, &src->spt_hash_table);
-    hash_next(&i);
-    for (; i.elem != NULL; hash_next(&i)) {
+    while (hash_next(&i)) {
         struct page *p = hash_entry(hash_cur(&i), struct page, hash_elem);
-        struct page *new_page;
         switch (p->operations->type) {
-            case VM_UNINIT:
-                new_page = calloc(1, sizeof(struct page));
-
-                struct lazy_read_file *lrf = calloc(1, sizeof(struct lazy_read_file));
-                memcpy(lrf, p->uninit.aux, sizeof(struct lazy_read_file));
-                uninit_new(new_page, p->va, p->uninit.init, p->uninit.type, lrf,
-                           p->uninit.page_initializer);  // 안되면 new_page -> p 로 바꾸기
-                hash_insert(&dst->spt_hash_table, &new_page->hash_elem);
-                break;
             case VM_ANON:
-                if (!vm_alloc_page(p->operations->type, p->va, p->writable)) {
-                    free(new_page);
-                    return false;
-                }
-                if (!vm_claim_page(p->va)) {
-                    free(new_page);
+                if (!vm_share_page(dst, p))
                     return false;
-                }
-                new_page = spt_find_page(&dst->spt_hash_table, p->va);
-                memcpy(new_page->frame->kva, p->frame->kva, PGSIZE);
+                break;
+            case VM_FILE:
+                lock_acquire(&frame_lock);
+                file_backed_writeback(p);
+                lock_release(&frame_lock);
                 break;
 
             default:
@@ -250,13 +1792,20 @@ bool supplemental_page_table_copy(struct supplemental_page_table *dst UNUSED,
     return true;
 }
 
-/* Free the resource hold by the supplemental page table */
+/* Free the resource hold by the supplemental page table.
+ * The whole user address space is torn down as one unmap batch. */
 void supplemental_page_table_kill(struct supplemental_page_table *spt UNUSED) {
     /* TODO: Destroy all the supplemental_page_table hold by thread and
      * TODO: writeback all the modified contents to the storage. */
-    // hash_clear(&spt->spt_hash_table, 구현한 hash_action_func);
-    // 모든콘텐츠 저장소에 다시쓰기 미구현
+    struct unmap_batch batch;
+
+    lock_acquire(&frame_lock);
+    vm_wait_range(spt, NULL, (void *)KERN_BASE);
+    vm_unmap_begin(&batch, thread_current()->pml4);
     hash_clear(&spt->spt_hash_table, hash_elem_destructor);
+    vm_unmap_end(&batch, NULL, (void *)KERN_BASE);
+    lock_release(&frame_lock);
+    vma_kill(spt);
 }
 
 /* Returns a hash value for page p. */
@@ -272,10 +1821,9 @@ static bool page_less(const struct hash_elem *a_, const struct hash_elem *b_, vo
     return a->va < b->va;
 }
 
-static void hash_elem_destructor(struct hash_elem *he, void *aux) {
+/* Destroys the page in HE.  FRAME_LOCK must be held. */
+static void hash_elem_destructor(struct hash_elem *he, void *aux UNUSED) {
     struct page *p = hash_entry(he, struct page, hash_elem);
-    if (p->frame != NULL) {
-        free(p->frame);
-    }
+    destroy(p);
     free(p);
 }
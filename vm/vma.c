@@ -0,0 +1,132 @@
+/* vma.c: Virtual memory areas.
+ *
+ * Each process keeps its regions (code, data, stack, mappings) in a
+ * list sorted by start address.  A region records its backing file,
+ * offset and permissions once; the per-page struct page is only built
+ * by the fault handler when an address in the region is first touched.
+ * Lookups remember the last hit, since faults tend to cluster. */
+
+#include "vm/vma.h"
+
+#include <debug.h>
+
+#include "filesys/file.h"
+#include "threads/malloc.h"
+#include "threads/vaddr.h"
+#include "vm/vm.h"
+
+static bool vma_less(const struct list_elem *a_, const struct list_elem *b_, void *aux UNUSED);
+
+/* Initializes the region list of SPT. */
+void vma_init(struct supplemental_page_table *spt) {
+    list_init(&spt->vma_list);
+    spt->vma_cache = NULL;
+}
+
+/* Adds the region [START, END) to SPT and returns it, or returns NULL
+ * if it would overlap an existing region or memory is short.  FILE, if
+ * not null, is owned by the region from then on and closed with it,
+ * even on failure. */
+struct vma *vma_create(struct supplemental_page_table *spt, void *start, void *end,
+                       enum vm_type type, bool writable, struct file *file, off_t ofs,
+                       size_t read_bytes, vm_initializer *init) {
+    ASSERT(pg_ofs(start) == 0 && pg_ofs(end) == 0);
+    ASSERT(start < end);
+
+    struct vma *vma = NULL;
+    if (vma_is_free(spt, start, end))
+        vma = malloc(sizeof *vma);
+    if (vma == NULL) {
+        file_close(file);
+        return NULL;
+    }
+
+    vma->start = start;
+    vma->end = end;
+    vma->type = type;
+    vma->writable = writable;
+    vma->file = file;
+    vma->ofs = ofs;
+    vma->read_bytes = read_bytes;
+    vma->init = init;
+    vma->advice = MADV_NORMAL;
+    list_insert_ordered(&spt->vma_list, &vma->elem, vma_less, NULL);
+    return vma;
+}
+
+/* Returns the region of SPT that contains VA, or NULL if none does. */
+struct vma *vma_find(struct supplemental_page_table *spt, const void *va) {
+    struct vma *vma = spt->vma_cache;
+    if (vma != NULL && vma->start <= va && va < vma->end)
+        return vma;
+
+    for (struct list_elem *e = list_begin(&spt->vma_list); e != list_end(&spt->vma_list);
+         e = list_next(e)) {
+        vma = list_entry(e, struct vma, elem);
+        if (va < vma->start)
+            break;
+        if (va < vma->end) {
+            spt->vma_cache = vma;
+            return vma;
+        }
+    }
+    return NULL;
+}
+
+/* Returns true if no region of SPT intersects [START, END). */
+bool vma_is_free(struct supplemental_page_table *spt, const void *start, const void *end) {
+    for (struct list_elem *e = list_begin(&spt->vma_list); e != list_end(&spt->vma_list);
+         e = list_next(e)) {
+        struct vma *vma = list_entry(e, struct vma, elem);
+        if (end <= vma->start)
+            break;
+        if (start < vma->end)
+            return false;
+    }
+    return true;
+}
+
+/* Removes VMA from SPT and frees it.  The caller must already have
+ * removed the pages instantiated inside it. */
+void vma_destroy(struct supplemental_page_table *spt, struct vma *vma) {
+    if (spt->vma_cache == vma)
+        spt->vma_cache = NULL;
+    list_remove(&vma->elem);
+    file_close(vma->file);
+    free(vma);
+}
+
+/* Copies every region of SRC into DST, which must have none.  File
+ * backed regions reopen their file so that each process owns its own
+ * handle.  Access hints are inherited. */
+bool vma_copy(struct supplemental_page_table *dst, struct supplemental_page_table *src) {
+    for (struct list_elem *e = list_begin(&src->vma_list); e != list_end(&src->vma_list);
+         e = list_next(e)) {
+        struct vma *vma = list_entry(e, struct vma, elem);
+        struct vma *copy;
+        struct file *file = NULL;
+
+        if (vma->file != NULL && (file = file_reopen(vma->file)) == NULL)
+            return false;
+        copy = vma_create(dst, vma->start, vma->end, vma->type, vma->writable, file, vma->ofs,
+                          vma->read_bytes, vma->init);
+        if (copy == NULL)
+            return false;
+        copy->advice = vma->advice;
+    }
+    return true;
+}
+
+/* Destroys every region of SPT. */
+void vma_kill(struct supplemental_page_table *spt) {
+    while (!list_empty(&spt->vma_list))
+        vma_destroy(spt, list_entry(list_front(&spt->vma_list), struct vma, elem));
+}
+
+/* Orders regions by start address. */
+static bool vma_less(const struct list_elem *a_, const struct list_elem *b_, void *aux UNUSED) {
+    const struct vma *a = list_entry(a_, struct vma, elem);
+    const struct vma *b = list_entry(b_, struct vma, elem);
+
+    return a->start < b->start;
+}
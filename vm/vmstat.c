@@ -0,0 +1,121 @@
+/* vmstat.c: Page fault counters and latency histograms.
+ *
+ * Every fault that vm_try_handle_fault() resolves is counted by class,
+ * both globally and for the faulting process, and its cost, measured
+ * with the time stamp counter, goes into a per-class log2 histogram.
+ * User programs read them through int 0x45 and int 0x46, like the
+ * other inspection interrupts, and the memory footprint of the process
+ * through int 0x47. */
+
+#include "vm/vmstat.h"
+
+#include <debug.h>
+
+#include "threads/interrupt.h"
+#include "threads/thread.h"
+
+static uint64_t fault_cnt[VM_FAULT_CLASS_CNT];
+static uint64_t fault_hist[VM_FAULT_CLASS_CNT][VM_FAULT_HIST_BUCKETS];
+static uint64_t oom_kill_cnt;
+
+static void inspect_fault_cnt(struct intr_frame *f);
+static void inspect_fault_hist(struct intr_frame *f);
+static void inspect_mem(struct intr_frame *f);
+
+/* Reads the time stamp counter. */
+static inline uint64_t rdtsc(void) {
+    uint32_t lo, hi;
+    asm volatile("rdtsc" : "=a"(lo), "=d"(hi));
+    return ((uint64_t)hi << 32) | lo;
+}
+
+/* Registers the inspection interrupts.
+ * int 0x45 - Fault count.
+ *   @RDX - Fault class
+ *   @RCX - VM_FAULT_GLOBAL or VM_FAULT_PROCESS
+ * int 0x46 - Fault latency histogram, for all processes.
+ *   @RDX - Fault class
+ *   @RCX - Histogram bucket
+ * int 0x47 - Memory counter.
+ *   @RDX - enum vm_mem_stat
+ * Output:
+ *   @RAX - The count, or 0 if the input is out of range. */
+void vmstat_init(void) {
+    intr_register_int(0x45, 3, INTR_OFF, inspect_fault_cnt, "Inspect Page Fault Count");
+    intr_register_int(0x46, 3, INTR_OFF, inspect_fault_hist, "Inspect Page Fault Latency");
+    intr_register_int(0x47, 3, INTR_OFF, inspect_mem, "Inspect Memory Footprint");
+}
+
+/* Returns the time at which a fault started being handled, to be
+ * passed to vmstat_end(). */
+uint64_t vmstat_begin(void) {
+    return rdtsc();
+}
+
+/* Records a fault of CLASS that started being handled at START. */
+void vmstat_end(enum vm_fault_class class, uint64_t start) {
+    uint64_t cycles = rdtsc() - start;
+    size_t bucket = 0;
+
+    ASSERT(class < VM_FAULT_CLASS_CNT);
+    while (bucket < VM_FAULT_HIST_BUCKETS - 1 && cycles >> (bucket + 1) != 0)
+        bucket++;
+
+    enum intr_level old_level = intr_disable();
+    fault_cnt[class]++;
+    fault_hist[class][bucket]++;
+    thread_current()->fault_cnt[class]++;
+    intr_set_level(old_level);
+}
+
+/* Records that the OOM killer killed a process. */
+void vmstat_oom_kill(void) {
+    enum intr_level old_level = intr_disable();
+    oom_kill_cnt++;
+    intr_set_level(old_level);
+}
+
+static void inspect_fault_cnt(struct intr_frame *f) {
+    uint64_t class = f->R.rdx, scope = f->R.rcx;
+
+    f->R.rax = 0;
+    if (class >= VM_FAULT_CLASS_CNT)
+        return;
+    if (scope == VM_FAULT_GLOBAL)
+        f->R.rax = fault_cnt[class];
+    else if (scope == VM_FAULT_PROCESS)
+        f->R.rax = thread_current()->fault_cnt[class];
+}
+
+static void inspect_fault_hist(struct intr_frame *f) {
+    uint64_t class = f->R.rdx, bucket = f->R.rcx;
+
+    f->R.rax = 0;
+    if (class < VM_FAULT_CLASS_CNT && bucket < VM_FAULT_HIST_BUCKETS)
+        f->R.rax = fault_hist[class][bucket];
+}
+
+static void inspect_mem(struct intr_frame *f) {
+    struct supplemental_page_table *spt = &thread_current()->spt;
+
+    switch (f->R.rdx) {
+        case VM_MEM_RESIDENT:
+            f->R.rax = spt->resident_pages;
+            break;
+        case VM_MEM_SWAPPED:
+            f->R.rax = spt->swapped_pages;
+            break;
+        case VM_MEM_OOM_KILLS:
+            f->R.rax = oom_kill_cnt;
+            break;
+        case VM_MEM_PEAK:
+            f->R.rax = spt->peak_resident_pages;
+            break;
+        case VM_MEM_LIMIT:
+            f->R.rax = spt->rss_limit;
+            break;
+        default:
+            f->R.rax = 0;
+            break;
+    }
+}
@@ -0,0 +1,260 @@
+/* zswap.c: Compressed cache in front of the swap disk.
+ *
+ * Pages headed for a swap slot are first compressed into kernel memory.
+ * The slot stays reserved on disk, but nothing is written there unless
+ * the page does not compress to a quarter of its size or the cache is
+ * full; in the latter case the least recently stored pages are written
+ * out to their slots to make room.  Entries are keyed by slot number,
+ * so the rest of the swap code keeps dealing in slots only.
+ *
+ * The compressor is a small LZ77 variant.  Its output is a sequence of
+ * tokens: a byte 0LLLLLLL is followed by L + 1 literal bytes, and a
+ * byte 1LLLLLLL followed by a 16-bit little-endian distance D copies
+ * L + LZ_MIN_MATCH bytes starting D bytes back. */
+
+#include "vm/zswap.h"
+
+#include <debug.h>
+#include <hash.h>
+#include <list.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "threads/malloc.h"
+#include "threads/palloc.h"
+#include "threads/synch.h"
+#include "threads/vaddr.h"
+#include "vm/swap.h"
+
+#define LZ_MIN_MATCH 4
+#define LZ_MAX_MATCH (LZ_MIN_MATCH + 0x7f)
+#define LZ_MAX_LITERALS 0x80
+#define LZ_HASH_BITS 10
+
+/* A compressed page. */
+struct zswap_entry {
+    size_t slot;              /* Swap slot the page belongs to. */
+    size_t size;              /* Bytes in DATA. */
+    struct hash_elem elem;    /* Element in ENTRIES. */
+    struct list_elem lru_elem; /* Element in LRU. */
+    uint8_t data[];           /* Compressed contents. */
+};
+
+/* Largest entry kept, header included: a quarter page. */
+#define ZSWAP_MAX_ENTRY (PGSIZE / 4)
+
+static struct hash entries;  /* Entries by slot. */
+static struct list lru;      /* Entries, least recently stored first. */
+static struct lock zswap_lock; /* Guards everything here. */
+static size_t pool_bytes;    /* Bytes held by entries. */
+static size_t pool_limit;    /* Most bytes entries may hold. */
+
+/* Scratch space, only used with ZSWAP_LOCK held. */
+static uint8_t *scratch;                       /* One page. */
+static uint16_t lz_table[1 << LZ_HASH_BITS];   /* Last position + 1 by hash. */
+
+static uint64_t entry_hash(const struct hash_elem *e, void *aux UNUSED);
+static bool entry_less(const struct hash_elem *a, const struct hash_elem *b, void *aux UNUSED);
+static struct zswap_entry *entry_find(size_t slot);
+static void entry_remove(struct zswap_entry *entry);
+static void writeback_oldest(void);
+static size_t lz_compress(const uint8_t *src, uint8_t *dst, size_t cap);
+static bool lz_decompress(const uint8_t *src, size_t size, uint8_t *dst);
+
+/* Sets up the cache.  It may hold up to an eighth of the user pool's
+ * worth of compressed data, but no more than a quarter of the free
+ * kernel pool, where it lives. */
+void zswap_init(void) {
+    size_t user_bytes = palloc_free_cnt(PAL_USER) * PGSIZE / 8;
+    size_t kernel_bytes = palloc_free_cnt(0) * PGSIZE / 4;
+
+    hash_init(&entries, entry_hash, entry_less, NULL);
+    list_init(&lru);
+    lock_init(&zswap_lock);
+    pool_bytes = 0;
+    pool_limit = user_bytes < kernel_bytes ? user_bytes : kernel_bytes;
+    scratch = palloc_get_page(PAL_ASSERT);
+}
+
+/* Stores the page at KVA compressed, as the contents of SLOT.  Returns
+ * false if the page does not compress well enough or there is no room,
+ * in which case the caller must write it to disk itself. */
+bool zswap_store(size_t slot, const void *kva) {
+    struct zswap_entry *entry;
+    size_t size;
+
+    lock_acquire(&zswap_lock);
+    if ((entry = entry_find(slot)) != NULL)
+        entry_remove(entry);
+    size = lz_compress(kva, scratch, ZSWAP_MAX_ENTRY - sizeof *entry);
+    if (size == 0 || sizeof *entry + size > pool_limit) {
+        lock_release(&zswap_lock);
+        return false;
+    }
+
+    while (pool_bytes + sizeof *entry + size > pool_limit)
+        writeback_oldest();
+
+    entry = malloc(sizeof *entry + size);
+    if (entry == NULL) {
+        lock_release(&zswap_lock);
+        return false;
+    }
+    entry->slot = slot;
+    entry->size = size;
+    memcpy(entry->data, scratch, size);
+    hash_insert(&entries, &entry->elem);
+    list_push_back(&lru, &entry->lru_elem);
+    pool_bytes += sizeof *entry + size;
+    lock_release(&zswap_lock);
+    return true;
+}
+
+/* Decompresses the contents of SLOT into KVA and returns true, or
+ * returns false if SLOT is not in the cache.  The entry stays until the
+ * slot is freed. */
+bool zswap_load(size_t slot, void *kva) {
+    lock_acquire(&zswap_lock);
+    struct zswap_entry *entry = entry_find(slot);
+    if (entry != NULL && !lz_decompress(entry->data, entry->size, kva))
+        PANIC("zswap: slot %zu is corrupt", slot);
+    lock_release(&zswap_lock);
+    return entry != NULL;
+}
+
+/* Returns true if the contents of SLOT are in the cache. */
+bool zswap_contains(size_t slot) {
+    lock_acquire(&zswap_lock);
+    bool found = entry_find(slot) != NULL;
+    lock_release(&zswap_lock);
+    return found;
+}
+
+/* Drops the cached contents of SLOT, if any.  Called when the slot is
+ * freed. */
+void zswap_invalidate(size_t slot) {
+    lock_acquire(&zswap_lock);
+    struct zswap_entry *entry = entry_find(slot);
+    if (entry != NULL)
+        entry_remove(entry);
+    lock_release(&zswap_lock);
+}
+
+/* Returns the entry for SLOT, or NULL.  ZSWAP_LOCK must be held. */
+static struct zswap_entry *entry_find(size_t slot) {
+    struct zswap_entry key;
+    struct hash_elem *e;
+
+    key.slot = slot;
+    e = hash_find(&entries, &key.elem);
+    return e != NULL ? hash_entry(e, struct zswap_entry, elem) : NULL;
+}
+
+/* Unlinks and frees ENTRY.  ZSWAP_LOCK must be held. */
+static void entry_remove(struct zswap_entry *entry) {
+    hash_delete(&entries, &entry->elem);
+    list_remove(&entry->lru_elem);
+    pool_bytes -= sizeof *entry + entry->size;
+    free(entry);
+}
+
+/* Writes the least recently stored entry out to its slot on disk and
+ * drops it.  ZSWAP_LOCK must be held, and the LRU list not empty. */
+static void writeback_oldest(void) {
+    struct zswap_entry *entry = list_entry(list_front(&lru), struct zswap_entry, lru_elem);
+
+    if (!lz_decompress(entry->data, entry->size, scratch))
+        PANIC("zswap: slot %zu is corrupt", entry->slot);
+    swap_write_disk(entry->slot, scratch);
+    entry_remove(entry);
+}
+
+/* Emits SRC[START, END) as literal runs into DST at *OP.  Returns false
+ * if that would take DST past CAP bytes. */
+static bool lz_flush_literals(const uint8_t *src, size_t start, size_t end, uint8_t *dst,
+                              size_t *op, size_t cap) {
+    while (start < end) {
+        size_t n = end - start < LZ_MAX_LITERALS ? end - start : LZ_MAX_LITERALS;
+        if (*op + 1 + n > cap)
+            return false;
+        dst[(*op)++] = n - 1;
+        memcpy(dst + *op, src + start, n);
+        *op += n;
+        start += n;
+    }
+    return true;
+}
+
+/* Compresses the page at SRC into DST.  Returns the compressed size, or
+ * 0 if it would exceed CAP bytes. */
+static size_t lz_compress(const uint8_t *src, uint8_t *dst, size_t cap) {
+    size_t ip = 0, op = 0, lit = 0;
+
+    memset(lz_table, 0, sizeof lz_table);
+    while (ip + LZ_MIN_MATCH <= PGSIZE) {
+        uint32_t seq;
+        memcpy(&seq, src + ip, sizeof seq);
+        size_t h = (uint32_t)(seq * 2654435761u) >> (32 - LZ_HASH_BITS);
+        size_t ref = lz_table[h];
+        lz_table[h] = ip + 1;
+
+        if (ref == 0 || memcmp(src + --ref, src + ip, LZ_MIN_MATCH)) {
+            ip++;
+            continue;
+        }
+
+        size_t len = LZ_MIN_MATCH;
+        while (ip + len < PGSIZE && len < LZ_MAX_MATCH && src[ref + len] == src[ip + len])
+            len++;
+        if (!lz_flush_literals(src, lit, ip, dst, &op, cap) || op + 3 > cap)
+            return 0;
+        dst[op++] = 0x80 | (len - LZ_MIN_MATCH);
+        dst[op++] = (ip - ref) & 0xff;
+        dst[op++] = (ip - ref) >> 8;
+        ip += len;
+        lit = ip;
+    }
+    return lz_flush_literals(src, lit, PGSIZE, dst, &op, cap) ? op : 0;
+}
+
+/* Decompresses SIZE bytes at SRC into the page at DST.  Returns false
+ * if the data is malformed. */
+static bool lz_decompress(const uint8_t *src, size_t size, uint8_t *dst) {
+    size_t ip = 0, op = 0;
+
+    while (ip < size) {
+        uint8_t token = src[ip++];
+        if (token & 0x80) {
+            size_t len = (token & 0x7f) + LZ_MIN_MATCH;
+            if (ip + 2 > size)
+                return false;
+            size_t dist = src[ip] | (src[ip + 1] << 8);
+            ip += 2;
+            if (dist == 0 || dist > op || op + len > PGSIZE)
+                return false;
+            /* Byte by byte: the source may overlap what we write. */
+            for (; len > 0; len--, op++)
+                dst[op] = dst[op - dist];
+        } else {
+            size_t n = (size_t)token + 1;
+            if (ip + n > size || op + n > PGSIZE)
+                return false;
+            memcpy(dst + op, src + ip, n);
+            ip += n;
+            op += n;
+        }
+    }
+    return op == PGSIZE;
+}
+
+/* Hashes entries by slot. */
+static uint64_t entry_hash(const struct hash_elem *e, void *aux UNUSED) {
+    const struct zswap_entry *entry = hash_entry(e, struct zswap_entry, elem);
+    return hash_bytes(&entry->slot, sizeof entry->slot);
+}
+
+/* Orders entries by slot. */
+static bool entry_less(const struct hash_elem *a, const struct hash_elem *b, void *aux UNUSED) {
+    return hash_entry(a, struct zswap_entry, elem)->slot <
+           hash_entry(b, struct zswap_entry, elem)->slot;
+}